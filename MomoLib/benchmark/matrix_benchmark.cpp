@@ -0,0 +1,249 @@
+/*
+matrix throughput benchmark with roofline reporting. It is a separate executable (it has its own main),
+build it from repository root with any C++17 compiler, for example:
+	g++ -std=c++17 -O2 -pthread -I MomoLib/headers MomoLib/benchmark/matrix_benchmark.cpp -o matrix_benchmark
+
+first memory bandwidth is measured with STREAM-like copy and triad loops, then every operation is timed
+for square sizes from --min-size to --max-size (powers of two) and every element type. For each run
+it prints GFLOP/s, bytes moved (compulsory traffic: every operand read once, result written once),
+arithmetic intensity and the roofline bound intensity * bandwidth, so memory-bound and compute-bound
+operations are easy to tell apart. pow is measured only up to size 1024, for integer types it is taken modulo prime
+(as mult_mod), so results do not overflow.
+Output is CSV (default) or JSON lines, one result per line.
+
+usage: matrix_benchmark [--min-size N] [--max-size N] [--ops list] [--types list] [--min-time seconds] [--format csv|json]
+	--ops:   comma separated subset of construct,copy,add,scale,mult,mult_mod,pow (default: all)
+	--types: comma separated subset of int,int64,float,double (default: all)
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "matrix.h"
+
+namespace
+{
+	using clock_type = std::chrono::steady_clock;
+
+	struct options
+	{
+		size_t min_size = 2;
+		size_t max_size = 4096;
+		double min_time = 0.2;
+		bool json = false;
+		std::vector<std::string> ops = { "construct", "copy", "add", "scale", "mult", "mult_mod", "pow" };
+		std::vector<std::string> types = { "int", "int64", "float", "double" };
+	};
+
+	struct result
+	{
+		std::string op, type;
+		size_t size;
+		size_t runs;
+		double seconds; // best time of one run
+		double flops;
+		double bytes;
+	};
+
+	// results are folded into this value, so compiler can not throw benchmarked code away
+	volatile double sink = 0;
+
+	std::vector<std::string> split(const std::string& list)
+	{
+		std::vector<std::string> res;
+		std::istringstream iss(list);
+		std::string item;
+		while (std::getline(iss, item, ','))
+		{
+			if (!item.empty()) res.push_back(item);
+		}
+		return res;
+	}
+
+	bool contains(const std::vector<std::string>& list, const std::string& item)
+	{
+		return std::find(list.begin(), list.end(), item) != list.end();
+	}
+
+	/*
+	runs f until [min_time] seconds are spent (at least once) and returns the best time of one run
+	*/
+	template<typename Func>
+	double best_time(Func&& f, double min_time, size_t& runs)
+	{
+		double best = 1e300, total = 0;
+		runs = 0;
+		do
+		{
+			auto start = clock_type::now();
+			f();
+			double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+			best = std::min(best, elapsed);
+			total += elapsed;
+			runs++;
+		} while (total < min_time);
+		return best;
+	}
+
+	/*
+	sustainable memory bandwidth in bytes per second: best of copy (2 words per element)
+	and triad (3 words per element) over arrays much larger than caches
+	*/
+	double measure_bandwidth(double min_time)
+	{
+		const size_t n = size_t(1) << 24;
+		std::vector<double> a(n, 1.0), b(n, 2.0), c(n, 0.0);
+		size_t runs;
+		double copy = best_time([&]() { std::memcpy(c.data(), a.data(), n * sizeof(double)); sink = sink + c[n / 2]; }, min_time, runs);
+		double triad = best_time([&]()
+		{
+			for (size_t i = 0; i < n; i++)
+			{
+				a[i] = b[i] + 3.0 * c[i];
+			}
+			sink = sink + a[n / 3];
+		}, min_time, runs);
+		return std::max(2.0 * n * sizeof(double) / copy, 3.0 * n * sizeof(double) / triad);
+	}
+
+	template<typename T>
+	momo::matrix<T> random_matrix(size_t n, unsigned seed)
+	{
+		momo::matrix<T> M(n);
+		for (size_t i = 0; i < n; i++)
+		{
+			for (size_t j = 0; j < n; j++)
+			{
+				seed = seed * 1103515245u + 12345u;
+				M.vec[i][j] = T((seed >> 16) % 7 + 1);
+			}
+		}
+		return M;
+	}
+
+	// products computed by momo::pow for given power: one per squaring and one per set bit except the first
+	size_t pow_products(long long power)
+	{
+		size_t products = 0;
+		for (long long p = power; p > 1; p >>= 1)
+		{
+			products++;
+		}
+		for (long long p = power; p > 0; p >>= 1)
+		{
+			products += p & 1;
+		}
+		return products - 1;
+	}
+
+	template<typename T>
+	void run_type(const std::string& type, const options& opt, std::vector<result>& results)
+	{
+		const double word = sizeof(T);
+		for (size_t n = opt.min_size; n <= opt.max_size; n *= 2)
+		{
+			const double n2 = double(n) * n, n3 = n2 * n;
+			momo::matrix<T> A = random_matrix<T>(n, 1), B = random_matrix<T>(n, 2), C(n);
+			auto bench = [&](const std::string& op, double flops, double bytes, auto&& f)
+			{
+				if (!contains(opt.ops, op)) return;
+				result r{ op, type, n, 0, 0, flops, bytes };
+				r.seconds = best_time(f, opt.min_time, r.runs);
+				results.push_back(r);
+				std::cerr << op << " " << type << " " << n << ": " << r.seconds * 1e3 << " ms\n";
+			};
+
+			bench("construct", 0, n2 * word, [&]() { momo::matrix<T> M(n); sink = sink + double(M.vec[n - 1][n - 1]); });
+			bench("copy", 0, 2 * n2 * word, [&]() { momo::matrix<T> M = A; sink = sink + double(M.vec[n - 1][n - 1]); });
+			bench("add", n2, 3 * n2 * word, [&]() { C = A + B; sink = sink + double(C.vec[0][0]); });
+			bench("scale", n2, 2 * n2 * word, [&]() { C = A * T(3); sink = sink + double(C.vec[0][0]); });
+			bench("mult", 2 * n3, 3 * n2 * word, [&]() { C = A * B; sink = sink + double(C.vec[0][0]); });
+			if constexpr (std::is_integral<T>::value)
+			{
+				// every multiply-add is followed by two reductions, they are counted as operations too
+				const T mod = T(sizeof(T) >= 8 ? 1000000007 : 30011);
+				bench("mult_mod", 4 * n3, 3 * n2 * word, [&]() { C = momo::mult(A, B, mod); sink = sink + double(C.vec[0][0]); });
+			}
+			const long long power = 10;
+			if (n <= 1024)
+			{
+				if constexpr (std::is_integral<T>::value)
+				{
+					// powers of integer matrices overflow quickly (signed overflow is UB), so they are taken modulo
+					const T mod = T(sizeof(T) >= 8 ? 1000000007 : 30011);
+					bench("pow", 4 * n3 * pow_products(power), 2 * n2 * word, [&]() { C = momo::pow(A, power, mod); sink = sink + double(C.vec[0][0]); });
+				}
+				else
+				{
+					bench("pow", 2 * n3 * pow_products(power), 2 * n2 * word, [&]() { C = momo::pow(A, power); sink = sink + double(C.vec[0][0]); });
+				}
+			}
+		}
+	}
+
+	void print(const std::vector<result>& results, double bandwidth, const options& opt)
+	{
+		if (!opt.json)
+		{
+			std::cout << "# bandwidth_gb_s=" << bandwidth / 1e9 << "\n";
+			std::cout << "op,type,size,runs,seconds,gflop_s,bytes,gb_s,intensity,roofline_gflop_s,bandwidth_fraction\n";
+		}
+		for (const result& r : results)
+		{
+			double gflops = r.flops / r.seconds / 1e9;
+			double gbs = r.bytes / r.seconds / 1e9;
+			double intensity = r.bytes > 0 ? r.flops / r.bytes : 0;
+			double roofline = intensity * bandwidth / 1e9;
+			double fraction = gbs * 1e9 / bandwidth;
+			if (opt.json)
+			{
+				std::cout << "{\"op\":\"" << r.op << "\",\"type\":\"" << r.type << "\",\"size\":" << r.size
+					<< ",\"runs\":" << r.runs << ",\"seconds\":" << r.seconds << ",\"gflop_s\":" << gflops
+					<< ",\"bytes\":" << r.bytes << ",\"gb_s\":" << gbs << ",\"intensity\":" << intensity
+					<< ",\"roofline_gflop_s\":" << roofline << ",\"bandwidth_fraction\":" << fraction
+					<< ",\"bandwidth_gb_s\":" << bandwidth / 1e9 << "}\n";
+			}
+			else
+			{
+				std::cout << r.op << "," << r.type << "," << r.size << "," << r.runs << "," << r.seconds << ","
+					<< gflops << "," << r.bytes << "," << gbs << "," << intensity << "," << roofline << "," << fraction << "\n";
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	options opt;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string key = argv[i], value = argv[i + 1];
+		if (key == "--min-size") opt.min_size = std::max<size_t>(1, std::strtoull(value.c_str(), nullptr, 10));
+		else if (key == "--max-size") opt.max_size = std::strtoull(value.c_str(), nullptr, 10);
+		else if (key == "--min-time") opt.min_time = std::atof(value.c_str());
+		else if (key == "--ops") opt.ops = split(value);
+		else if (key == "--types") opt.types = split(value);
+		else if (key == "--format") opt.json = value == "json";
+		else
+		{
+			std::cerr << "unknown option " << key << "\n";
+			return 1;
+		}
+	}
+
+	double bandwidth = measure_bandwidth(opt.min_time);
+	std::cerr << "memory bandwidth: " << bandwidth / 1e9 << " GB/s\n";
+
+	std::vector<result> results;
+	if (contains(opt.types, "int")) run_type<int>("int", opt, results);
+	if (contains(opt.types, "int64")) run_type<long long>("int64", opt, results);
+	if (contains(opt.types, "float")) run_type<float>("float", opt, results);
+	if (contains(opt.types, "double")) run_type<double>("double", opt, results);
+	print(results, bandwidth, opt);
+}
@@ -0,0 +1,265 @@
+/*
+treap benchmark: iterative momo::treap against the recursive algorithms it used before. The same treap is also
+measured with thread-local splitmix64 priorities and with nodes taken from momo::pool_allocator, as well as
+index-based momo::compact_treap (both layouts).
+It is a separate executable (it has its own main), build it from repository root, for example:
+	g++ -std=c++17 -O2 -I MomoLib/headers MomoLib/benchmark/treap_benchmark.cpp -o treap_benchmark
+
+usage: treap_benchmark [nodes] (default: 10000000)
+every phase (insert of random keys, insert of sorted keys, find, erase, clear) is timed for every version,
+results are printed as CSV: implementation,phase,nodes,seconds,ns_per_op
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "treap.h"
+#include "pool_allocator.h"
+#include "compact_treap.h"
+
+momo::random_int64::Generator momo::random_int64::generator;
+
+namespace
+{
+	using clock_type = std::chrono::steady_clock;
+
+	/*
+	reference treap with recursive split / merge / insert / erase / find, as in treap.h before iterative rewrite
+	*/
+	class recursive_treap
+	{
+		struct Node
+		{
+			int value;
+			uint64_t priority;
+			size_t sub_tree_size = 1;
+			Node* left = nullptr;
+			Node* right = nullptr;
+
+			Node(int value, uint64_t priority)
+				: value(value), priority(priority) { }
+
+			void _update()
+			{
+				sub_tree_size = 1;
+				if (left != nullptr) sub_tree_size += left->sub_tree_size;
+				if (right != nullptr) sub_tree_size += right->sub_tree_size;
+			}
+		};
+
+		Node* _root = nullptr;
+
+		std::pair<Node*, Node*> _split(Node* root, int K)
+		{
+			if (root == nullptr) return { nullptr, nullptr };
+			if (K < root->value)
+			{
+				auto subTree = _split(root->left, K);
+				root->left = subTree.second;
+				root->_update();
+				return { subTree.first, root };
+			}
+			auto subTree = _split(root->right, K);
+			root->right = subTree.first;
+			root->_update();
+			return { root, subTree.second };
+		}
+
+		Node* _merge(Node* tree_left, Node* tree_right)
+		{
+			if (tree_left == nullptr) return tree_right;
+			if (tree_right == nullptr) return tree_left;
+			if (tree_left->priority < tree_right->priority)
+			{
+				tree_left->right = _merge(tree_left->right, tree_right);
+				tree_left->_update();
+				return tree_left;
+			}
+			tree_right->left = _merge(tree_left, tree_right->left);
+			tree_right->_update();
+			return tree_right;
+		}
+
+		Node* _insert_node(Node* root, Node* node)
+		{
+			if (root == nullptr) return node;
+			if (root->priority < node->priority)
+			{
+				if (root->value < node->value) root->right = _insert_node(root->right, node);
+				else root->left = _insert_node(root->left, node);
+				root->_update();
+				return root;
+			}
+			auto subTree = _split(root, node->value);
+			node->left = subTree.first;
+			node->right = subTree.second;
+			node->_update();
+			return node;
+		}
+
+		Node* _erase(Node* root, int value)
+		{
+			if (root == nullptr) return nullptr;
+			if (root->value < value) root->right = _erase(root->right, value);
+			else if (value < root->value) root->left = _erase(root->left, value);
+			else
+			{
+				Node* toDelete = root;
+				root = _merge(root->left, root->right);
+				delete toDelete;
+				if (root == nullptr) return nullptr;
+			}
+			root->_update();
+			return root;
+		}
+
+		Node* _find(Node* root, int value) const
+		{
+			if (root == nullptr) return nullptr;
+			if (root->value < value) return _find(root->right, value);
+			if (value < root->value) return _find(root->left, value);
+			return root;
+		}
+
+		void _destroy(Node* node)
+		{
+			if (node == nullptr) return;
+			_destroy(node->left);
+			_destroy(node->right);
+			delete node;
+		}
+	public:
+		~recursive_treap()
+		{
+			clear();
+		}
+
+		void insert(int value)
+		{
+			_root = _insert_node(_root, new Node(value, momo::random_int64::get()));
+		}
+
+		void erase(int value)
+		{
+			_root = _erase(_root, value);
+		}
+
+		bool contains(int value) const
+		{
+			return _find(_root, value) != nullptr;
+		}
+
+		void clear()
+		{
+			_destroy(_root);
+			_root = nullptr;
+		}
+	};
+
+	template<typename Treap>
+	struct momo_treap
+	{
+		Treap tree;
+
+		void insert(int value)
+		{
+			tree.insert(value);
+		}
+
+		void erase(int value)
+		{
+			tree.erase(value);
+		}
+
+		bool contains(int value) const
+		{
+			return tree.find(value) != tree.end();
+		}
+
+		void clear()
+		{
+			tree.clear();
+		}
+	};
+
+	template<typename Treap>
+	struct momo_compact_treap
+	{
+		Treap tree;
+
+		void insert(int value)
+		{
+			tree.insert(value);
+		}
+
+		void erase(int value)
+		{
+			tree.erase(value);
+		}
+
+		bool contains(int value) const
+		{
+			return tree.contains(value);
+		}
+
+		void clear()
+		{
+			tree.clear();
+		}
+	};
+
+	template<typename Func>
+	double measure(Func&& f)
+	{
+		auto start = clock_type::now();
+		f();
+		return std::chrono::duration<double>(clock_type::now() - start).count();
+	}
+
+	template<typename Tree>
+	void run(const std::string& name, const std::vector<int>& keys)
+	{
+		const size_t n = keys.size();
+		auto report = [&](const std::string& phase, double seconds)
+		{
+			std::cout << name << "," << phase << "," << n << "," << seconds << "," << seconds * 1e9 / n << std::endl;
+		};
+		size_t found = 0;
+		{
+			Tree tree;
+			report("insert_random", measure([&]() { for (int key : keys) tree.insert(key); }));
+			report("find", measure([&]() { for (int key : keys) found += tree.contains(key); }));
+			report("erase", measure([&]() { for (size_t i = 0; i < n; i += 2) tree.erase(keys[i]); }));
+			report("clear", measure([&]() { tree.clear(); }));
+		}
+		{
+			Tree tree;
+			report("insert_sorted", measure([&]() { for (size_t i = 0; i < n; i++) tree.insert((int)i); }));
+			report("clear_sorted", measure([&]() { tree.clear(); }));
+		}
+		if (found != n) std::cerr << name << ": find returned wrong results\n";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+	std::vector<int> keys(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		keys[i] = (int)i;
+	}
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+
+	std::cout << "implementation,phase,nodes,seconds,ns_per_op\n";
+	run<recursive_treap>("recursive", keys);
+	run<momo_treap<momo::treap<int> > >("iterative", keys);
+	run<momo_treap<momo::treap<int, uint64_t, momo::random_splitmix64> > >("splitmix", keys);
+	run<momo_treap<momo::treap<int, uint64_t, momo::random_int64, momo::pool_allocator> > >("pooled", keys);
+	run<momo_compact_treap<momo::compact_treap<int> > >("compact", keys);
+	run<momo_compact_treap<momo::compact_treap<int, uint32_t, momo::random_int64, true> > >("compact_split", keys);
+}
@@ -0,0 +1,532 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "treap.h"
+
+namespace momo
+{
+	/*
+	node storage of compact_treap: array of structures, all fields of a node are stored together.
+	Node with index 0 is a sentinel with size 0, it is used instead of null child
+	*/
+	template<typename T, typename Priority, typename Index>
+	struct compact_treap_nodes
+	{
+		struct node
+		{
+			T value;
+			Index left = 0;
+			Index right = 0;
+			Index size = 0;
+			Priority priority = 0;
+		};
+
+		std::vector<node> nodes;
+
+		compact_treap_nodes()
+			: nodes(1) { }
+
+		inline T& value(Index i) { return nodes[i].value; }
+		inline const T& value(Index i) const { return nodes[i].value; }
+		inline Index& left(Index i) { return nodes[i].left; }
+		inline Index left(Index i) const { return nodes[i].left; }
+		inline Index& right(Index i) { return nodes[i].right; }
+		inline Index right(Index i) const { return nodes[i].right; }
+		inline Index& size(Index i) { return nodes[i].size; }
+		inline Index size(Index i) const { return nodes[i].size; }
+		inline Priority& priority(Index i) { return nodes[i].priority; }
+		inline Priority priority(Index i) const { return nodes[i].priority; }
+
+		// amount of nodes including sentinel, it is size_t so it does not wrap around when Index is exhausted
+		inline size_t count() const { return nodes.size(); }
+
+		template<typename U>
+		inline void push(U&& value, Priority priority)
+		{
+			nodes.push_back(node{ std::forward<U>(value), 0, 0, 1, priority });
+		}
+
+		inline void reserve(size_t n)
+		{
+			nodes.reserve(n + 1);
+		}
+
+		inline void clear()
+		{
+			nodes.resize(1);
+		}
+
+		inline void shrink_to_fit()
+		{
+			nodes.shrink_to_fit();
+		}
+
+		static constexpr size_t node_bytes = sizeof(node);
+	};
+
+	/*
+	node storage of compact_treap: structure of arrays, values with child links are kept apart from priorities
+	and subtree sizes, so searches touch only values and links and order statistics touch only sizes
+	*/
+	template<typename T, typename Priority, typename Index>
+	struct compact_treap_split_nodes
+	{
+		struct node
+		{
+			T value;
+			Index left = 0;
+			Index right = 0;
+		};
+
+		std::vector<node> nodes;
+		std::vector<Index> sizes;
+		std::vector<Priority> priorities;
+
+		compact_treap_split_nodes()
+			: nodes(1), sizes(1, 0), priorities(1, 0) { }
+
+		inline T& value(Index i) { return nodes[i].value; }
+		inline const T& value(Index i) const { return nodes[i].value; }
+		inline Index& left(Index i) { return nodes[i].left; }
+		inline Index left(Index i) const { return nodes[i].left; }
+		inline Index& right(Index i) { return nodes[i].right; }
+		inline Index right(Index i) const { return nodes[i].right; }
+		inline Index& size(Index i) { return sizes[i]; }
+		inline Index size(Index i) const { return sizes[i]; }
+		inline Priority& priority(Index i) { return priorities[i]; }
+		inline Priority priority(Index i) const { return priorities[i]; }
+
+		// amount of nodes including sentinel, it is size_t so it does not wrap around when Index is exhausted
+		inline size_t count() const { return nodes.size(); }
+
+		template<typename U>
+		inline void push(U&& value, Priority priority)
+		{
+			nodes.push_back(node{ std::forward<U>(value), 0, 0 });
+			sizes.push_back(1);
+			priorities.push_back(priority);
+		}
+
+		inline void reserve(size_t n)
+		{
+			nodes.reserve(n + 1);
+			sizes.reserve(n + 1);
+			priorities.reserve(n + 1);
+		}
+
+		inline void clear()
+		{
+			nodes.resize(1);
+			sizes.resize(1);
+			priorities.resize(1);
+		}
+
+		inline void shrink_to_fit()
+		{
+			nodes.shrink_to_fit();
+			sizes.shrink_to_fit();
+			priorities.shrink_to_fit();
+		}
+
+		static constexpr size_t node_bytes = sizeof(node) + sizeof(Index) + sizeof(Priority);
+	};
+
+	/*
+	treap (ordered multiset) which keeps all nodes in contiguous arrays and links them with [Index] instead of pointers.
+	With default 32-bit index and 32-bit priority node of int takes 20 bytes instead of 48 in treap, and nodes
+	allocated one after another are neighbours in memory. [SplitArrays] selects structure of arrays layout
+	(see compact_treap_split_nodes). Erased nodes are reused by next inserts, memory is returned by clear() and shrink_to_fit().
+	T must be default constructible (sentinel node holds T()), treap can hold at most max_size() values,
+	insert throws std::length_error when there are no free indices left
+	*/
+	template<typename T, typename Priority = uint32_t, typename Random = random_int64, bool SplitArrays = false, typename Index = uint32_t>
+	class compact_treap
+	{
+		using storage = typename std::conditional<SplitArrays,
+			compact_treap_split_nodes<T, Priority, Index>,
+			compact_treap_nodes<T, Priority, Index> >::type;
+
+		storage _nodes;
+		Index _root = 0;
+		Index _free = 0; // list of erased nodes linked by left index
+		std::vector<Index> _path; // scratch stack of split / merge, kept to avoid allocations
+
+		template<typename U>
+		Index _new_node(U&& value)
+		{
+			Priority priority = treap_priority<Priority, Random>(static_cast<const T&>(value));
+			if (_free != 0)
+			{
+				Index node = _free;
+				_free = _nodes.left(node);
+				_nodes.value(node) = std::forward<U>(value);
+				_nodes.left(node) = 0;
+				_nodes.right(node) = 0;
+				_nodes.size(node) = 1;
+				_nodes.priority(node) = priority;
+				return node;
+			}
+			// the next index would wrap around to the sentinel 0 and corrupt the tree
+			if (_nodes.count() - 1 >= max_size()) throw std::length_error("compact_treap: too many nodes for Index type");
+			_nodes.push(std::forward<U>(value), priority);
+			return Index(_nodes.count() - 1);
+		}
+
+		void _free_node(Index node)
+		{
+			_nodes.value(node) = T();
+			_nodes.left(node) = _free;
+			_free = node;
+		}
+
+		inline void _update(Index node)
+		{
+			_nodes.size(node) = _nodes.size(_nodes.left(node)) + _nodes.size(_nodes.right(node)) + 1;
+		}
+
+		void _update_path(size_t base)
+		{
+			while (_path.size() > base)
+			{
+				_update(_path.back());
+				_path.pop_back();
+			}
+		}
+
+		/*
+		splits [root] into values which are less or equal to [value] (less if [strict]) and the rest.
+		Both trees are built top-down by hooking nodes to the right / left link of the last node of each tree
+		*/
+		std::pair<Index, Index> _split(Index root, const T& value, bool strict)
+		{
+			std::pair<Index, Index> res(0, 0);
+			Index* left_hook = &res.first;
+			Index* right_hook = &res.second;
+			size_t base = _path.size();
+			while (root != 0)
+			{
+				_path.push_back(root);
+				bool to_left = strict ? _nodes.value(root) < value : !(value < _nodes.value(root));
+				if (to_left)
+				{
+					*left_hook = root;
+					left_hook = &_nodes.right(root);
+				}
+				else
+				{
+					*right_hook = root;
+					right_hook = &_nodes.left(root);
+				}
+				root = *(to_left ? left_hook : right_hook);
+			}
+			*left_hook = *right_hook = 0;
+			_update_path(base);
+			return res;
+		}
+
+		Index _merge(Index tree_left, Index tree_right)
+		{
+			Index res = 0;
+			Index* hook = &res;
+			size_t base = _path.size();
+			while (tree_left != 0 && tree_right != 0)
+			{
+				if (_nodes.priority(tree_left) < _nodes.priority(tree_right))
+				{
+					*hook = tree_left;
+					_path.push_back(tree_left);
+					hook = &_nodes.right(tree_left);
+					tree_left = *hook;
+				}
+				else
+				{
+					*hook = tree_right;
+					_path.push_back(tree_right);
+					hook = &_nodes.left(tree_right);
+					tree_right = *hook;
+				}
+			}
+			*hook = (tree_left != 0) ? tree_left : tree_right;
+			_update_path(base);
+			return res;
+		}
+
+		Index _find(const T& value) const
+		{
+			Index node = _root;
+			while (node != 0)
+			{
+				if (_nodes.value(node) < value) node = _nodes.right(node);
+				else if (value < _nodes.value(node)) node = _nodes.left(node);
+				else return node;
+			}
+			return 0;
+		}
+
+		template<typename U>
+		void _insert(U&& value)
+		{
+			// node is created first: vector may reallocate, all index references below stay valid after that
+			Index node = _new_node(std::forward<U>(value));
+			const T& key = _nodes.value(node);
+			Priority priority = _nodes.priority(node);
+			Index* hook = &_root;
+			Index current = _root;
+			while (current != 0 && _nodes.priority(current) < priority)
+			{
+				_nodes.size(current)++;
+				// equal values go right as in _split, so duplicates do not form a chain
+				hook = (key < _nodes.value(current)) ? &_nodes.left(current) : &_nodes.right(current);
+				current = *hook;
+			}
+			std::pair<Index, Index> sub_trees = _split(current, key, false);
+			_nodes.left(node) = sub_trees.first;
+			_nodes.right(node) = sub_trees.second;
+			_update(node);
+			*hook = node;
+		}
+
+		template<typename SortedIt>
+		Index _build(const SortedIt& first, const SortedIt& last)
+		{
+			std::vector<Index> st;
+			Index root = 0;
+			for (SortedIt it = first; it != last; it++)
+			{
+				Index current = _new_node(*it);
+				Index last_popped = 0;
+				while (!st.empty())
+				{
+					if (_nodes.priority(st.back()) < _nodes.priority(current))
+					{
+						_nodes.right(st.back()) = current;
+						break;
+					}
+					last_popped = st.back();
+					_update(last_popped);
+					st.pop_back();
+				}
+				if (st.empty()) root = current;
+				_nodes.left(current) = last_popped;
+				st.push_back(current);
+			}
+			while (!st.empty())
+			{
+				_update(st.back());
+				st.pop_back();
+			}
+			return root;
+		}
+	public:
+		using value_type = T;
+		using index_type = Index;
+		using priority_type = Priority;
+
+		// bytes taken by one node, vector growth reserve is not counted
+		static constexpr size_t node_bytes = storage::node_bytes;
+
+		compact_treap() = default;
+
+		template<typename SortedIt>
+		compact_treap(const SortedIt& first, const SortedIt& last)
+		{
+			_root = _build(first, last);
+		}
+
+		inline size_t size() const noexcept
+		{
+			return _nodes.size(_root);
+		}
+
+		inline size_t max_size() const noexcept
+		{
+			return std::numeric_limits<Index>::max() - 1;
+		}
+
+		inline bool empty() const noexcept
+		{
+			return _root == 0;
+		}
+
+		inline void clear()
+		{
+			_nodes.clear();
+			_root = _free = 0;
+		}
+
+		// reserves place for [n] nodes, so inserts do not reallocate arrays
+		inline void reserve(size_t n)
+		{
+			_nodes.reserve(n);
+		}
+
+		inline void shrink_to_fit()
+		{
+			_nodes.shrink_to_fit();
+			_path.shrink_to_fit();
+		}
+
+		template<typename SortedIt>
+		inline void rebuild(const SortedIt& first, const SortedIt& last)
+		{
+			clear();
+			_root = _build(first, last);
+		}
+
+		inline void insert(const value_type& value)
+		{
+			_insert(value);
+		}
+
+		inline void insert(value_type&& value)
+		{
+			_insert(std::move(value));
+		}
+
+		// erases one value which is equal to [value], returns false if there is none
+		bool erase(const value_type& value)
+		{
+			if (_find(value) == 0) return false;
+			Index* hook = &_root;
+			Index node = _root;
+			while (true)
+			{
+				if (_nodes.value(node) < value) hook = &_nodes.right(node);
+				else if (value < _nodes.value(node)) hook = &_nodes.left(node);
+				else break;
+				_nodes.size(node)--;
+				node = *hook;
+			}
+			*hook = _merge(_nodes.left(node), _nodes.right(node));
+			_free_node(node);
+			return true;
+		}
+
+		inline bool contains(const value_type& value) const
+		{
+			return _find(value) != 0;
+		}
+
+		inline size_t count(const value_type& value) const
+		{
+			return order_of_key_upper(value) - order_of_key(value);
+		}
+
+		inline const value_type& left() const
+		{
+			Index node = _root;
+			while (_nodes.left(node) != 0) node = _nodes.left(node);
+			return _nodes.value(node);
+		}
+
+		inline const value_type& right() const
+		{
+			Index node = _root;
+			while (_nodes.right(node) != 0) node = _nodes.right(node);
+			return _nodes.value(node);
+		}
+
+		/*
+		returns [index]-th smallest value, index must be less than size()
+		*/
+		inline const value_type& nth(size_t index) const
+		{
+			Index node = _root;
+			while (true)
+			{
+				size_t left_size = _nodes.size(_nodes.left(node));
+				if (index < left_size)
+				{
+					node = _nodes.left(node);
+				}
+				else if (index == left_size)
+				{
+					return _nodes.value(node);
+				}
+				else
+				{
+					index -= left_size + 1;
+					node = _nodes.right(node);
+				}
+			}
+		}
+
+		// returns amount of values which are less or equal to [value]
+		inline size_t order_of_key_upper(const value_type& value) const
+		{
+			size_t order = 0;
+			Index node = _root;
+			while (node != 0)
+			{
+				if (value < _nodes.value(node))
+				{
+					node = _nodes.left(node);
+				}
+				else
+				{
+					order += 1 + _nodes.size(_nodes.left(node));
+					node = _nodes.right(node);
+				}
+			}
+			return order;
+		}
+
+		// returns amount of values which are less than [value]
+		inline size_t order_of_key(const value_type& value) const
+		{
+			size_t order = 0;
+			Index node = _root;
+			while (node != 0)
+			{
+				if (_nodes.value(node) < value)
+				{
+					order += 1 + _nodes.size(_nodes.left(node));
+					node = _nodes.right(node);
+				}
+				else
+				{
+					node = _nodes.left(node);
+				}
+			}
+			return order;
+		}
+
+		// calls func(value) for every value in order
+		template<typename Func>
+		void apply_visitor(Func&& func) const
+		{
+			std::vector<Index> st;
+			Index node = _root;
+			while (node != 0 || !st.empty())
+			{
+				while (node != 0)
+				{
+					st.push_back(node);
+					node = _nodes.left(node);
+				}
+				node = st.back();
+				st.pop_back();
+				func(_nodes.value(node));
+				node = _nodes.right(node);
+			}
+		}
+
+		inline void swap(compact_treap& tr)
+		{
+			std::swap(_nodes, tr._nodes);
+			std::swap(_root, tr._root);
+			std::swap(_free, tr._free);
+		}
+	};
+
+	template<typename T, typename P, typename R, bool S, typename I>
+	inline void swap(compact_treap<T, P, R, S, I>& tr1, compact_treap<T, P, R, S, I>& tr2)
+	{
+		tr1.swap(tr2);
+	}
+}
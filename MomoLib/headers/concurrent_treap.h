@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "persistent_treap.h"
+
+namespace momo
+{
+	/*
+	ordered multiset which can be used by many threads at once. Readers never lock: they atomically take the last
+	published version (persistent_treap, see persistent_treap.h) and search it, published versions are never changed.
+	Writers publish their operation and one of them becomes combiner: it applies all pending operations in one batch
+	to the working version and publishes new version in O(1), other writers spin with yield() until their operation
+	is marked as done, so writers do not fight for the tree and every update costs O(log n) copied nodes at most once
+	per batch. Update is visible to all readers when insert / erase returns. If operation throws (bad_alloc or copy of T),
+	exception is rethrown by insert / erase of the writer which requested it and the tree is left unchanged by that
+	operation. Priorities are generated only by combiner, but Random should still be thread-safe
+	if other treaps use it at the same time (random_splitmix64 is default for this reason)
+	*/
+	template<typename T, typename Priority = uint64_t, typename Random = random_splitmix64, template<typename> class Alloc = std::allocator>
+	class concurrent_treap
+	{
+	public:
+		using value_type = T;
+		using version_type = persistent_treap<T, Priority, Random, Alloc>;
+	private:
+		enum class operation_type
+		{
+			insert,
+			erase,
+		};
+
+		struct operation
+		{
+			operation_type type;
+			const T& value;
+			bool result = false;
+			std::exception_ptr error; // set by combiner if operation has thrown
+			std::atomic<bool> done{ false };
+
+			operation(operation_type type, const T& value)
+				: type(type), value(value) { }
+		};
+
+		std::shared_ptr<const version_type> _published;
+		version_type _current; // changed only by combiner
+		std::mutex _pending_mutex;
+		std::vector<operation*> _pending;
+		std::mutex _combiner_mutex;
+		std::vector<operation*> _batch; // operations taken by combiner, kept to avoid allocations
+
+		// never throws: exception of an operation is passed to its writer, so all writers of the batch are released
+		void _combine() noexcept
+		{
+			{
+				std::lock_guard<std::mutex> lock(_pending_mutex);
+				_batch.swap(_pending);
+			}
+			if (_batch.empty()) return;
+			std::shared_ptr<version_type> next;
+			try
+			{
+				// allocated before the batch is applied, so publishing can not fail after the working version is changed
+				next = std::make_shared<version_type>(_current);
+			}
+			catch (...)
+			{
+				std::exception_ptr error = std::current_exception();
+				for (operation* op : _batch) op->error = error;
+			}
+			if (next)
+			{
+				for (operation* op : _batch)
+				{
+					try
+					{
+						if (op->type == operation_type::insert)
+						{
+							_current.insert(op->value);
+							op->result = true;
+						}
+						else
+						{
+							op->result = _current.erase(op->value);
+						}
+					}
+					catch (...)
+					{
+						// persistent_treap is left unchanged by operation which has thrown
+						op->error = std::current_exception();
+					}
+				}
+				*next = _current;
+				std::atomic_store(&_published, std::shared_ptr<const version_type>(std::move(next)));
+			}
+			for (operation* op : _batch)
+			{
+				op->done.store(true, std::memory_order_release);
+			}
+			_batch.clear();
+		}
+
+		bool _execute(operation_type type, const T& value)
+		{
+			operation op(type, value);
+			{
+				std::lock_guard<std::mutex> lock(_pending_mutex);
+				_pending.push_back(&op);
+			}
+			while (!op.done.load(std::memory_order_acquire))
+			{
+				std::unique_lock<std::mutex> lock(_combiner_mutex, std::try_to_lock);
+				if (lock.owns_lock())
+				{
+					// operation could be applied by previous combiner while we were taking the lock
+					if (!op.done.load(std::memory_order_acquire)) _combine();
+				}
+				else
+				{
+					std::this_thread::yield();
+				}
+			}
+			if (op.error) std::rethrow_exception(op.error);
+			return op.result;
+		}
+	public:
+		concurrent_treap()
+			: _published(std::make_shared<const version_type>()) { }
+
+		template<typename SortedIt>
+		concurrent_treap(const SortedIt& first, const SortedIt& last)
+			: _current(first, last)
+		{
+			_published = std::make_shared<const version_type>(_current);
+		}
+
+		concurrent_treap(const concurrent_treap&) = delete;
+		concurrent_treap& operator=(const concurrent_treap&) = delete;
+
+		// current version of all values, it is never changed by later updates. O(1)
+		inline version_type snapshot() const
+		{
+			return *std::atomic_load(&_published);
+		}
+
+		inline void insert(const value_type& value)
+		{
+			_execute(operation_type::insert, value);
+		}
+
+		// erases one value equal to [value], returns false if there is none
+		inline bool erase(const value_type& value)
+		{
+			return _execute(operation_type::erase, value);
+		}
+
+		inline bool contains(const value_type& value) const
+		{
+			return std::atomic_load(&_published)->contains(value);
+		}
+
+		/*
+		copies value equal to [value] to [res], returns false if there is none. Node can be freed by writers
+		as soon as version is dropped, so value is copied instead of returning a pointer
+		*/
+		inline bool find(const value_type& value, value_type& res) const
+		{
+			std::shared_ptr<const version_type> version = std::atomic_load(&_published);
+			const value_type* ptr = version->find(value);
+			if (ptr == nullptr) return false;
+			res = *ptr;
+			return true;
+		}
+
+		inline size_t count(const value_type& value) const
+		{
+			return std::atomic_load(&_published)->count(value);
+		}
+
+		inline size_t size() const
+		{
+			return std::atomic_load(&_published)->size();
+		}
+
+		inline bool empty() const
+		{
+			return std::atomic_load(&_published)->empty();
+		}
+
+		// calls func(value) for every value of current version in order
+		template<typename Func>
+		void apply_visitor(Func&& func) const
+		{
+			std::atomic_load(&_published)->apply_visitor(std::forward<Func>(func));
+		}
+	};
+}
@@ -0,0 +1,577 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "treap.h"
+
+namespace momo
+{
+	/*
+	implicit treap (rope). Elements are ordered by position instead of by key: position of a node is the size of
+	everything to the left of it, so insert_at, erase_at and nth work in O(log n) and any range can be cut out with split.
+	Every node keeps summary of its subtree described by [Summary] policy (see treap_no_summary), so range queries
+	are O(log n). If policy has update_type, range updates are applied lazily; reverse of a range is always supported
+	*/
+	template<typename T, typename Summary = treap_no_summary<T>, typename Random = random_int64, template<typename> class Alloc = std::allocator>
+	class implicit_treap
+	{
+	public:
+		using value_type = T;
+		using summary_type = typename Summary::summary_type;
+		using update_type = typename treap_update_type<Summary>::type;
+		using priority_type = typename Random::RandomReturnType;
+		using implicit_treap_pair = std::pair<implicit_treap, implicit_treap>;
+
+		static constexpr bool has_update = treap_has_update<Summary>::value;
+	private:
+		struct Node
+		{
+			T value;
+			priority_type priority;
+			size_t sub_tree_size = 1;
+			Node* left = nullptr;
+			Node* right = nullptr;
+			summary_type summary;
+			update_type pending = update_type();
+			bool has_pending = false;
+			bool reversed = false;
+
+			template<typename U>
+			Node(U&& value, priority_type priority)
+				: value(std::forward<U>(value)), priority(priority), summary(Summary::summarize(this->value))
+			{
+
+			}
+		};
+
+		using node_ptr = Node*;
+		using node_ptr_pair = std::pair<node_ptr, node_ptr>;
+		using allocator = Alloc<Node>;
+		using allocator_traits = std::allocator_traits<allocator>;
+
+		node_ptr _root = nullptr;
+		allocator _alloc;
+		std::vector<node_ptr> _path; // scratch stack of modifying operations, kept to avoid allocations
+
+		template<typename U>
+		node_ptr _construct_node(U&& value)
+		{
+			node_ptr node = allocator_traits::allocate(_alloc, 1);
+			allocator_traits::construct(_alloc, node, std::forward<U>(value), Random::get());
+			return node;
+		}
+
+		void _destroy_node(node_ptr node) noexcept
+		{
+			allocator_traits::destroy(_alloc, node);
+			allocator_traits::deallocate(_alloc, node, 1);
+		}
+
+		// destroys subtree without recursion, see treap_core::destroy_tree
+		void _destroy_tree(node_ptr node) noexcept
+		{
+			treap_core<Node>::destroy_tree(node, [this](node_ptr p) { _destroy_node(p); });
+		}
+
+		// copies nodes with their pending operations
+		node_ptr _deep_copy(const node_ptr from)
+		{
+			return treap_core<Node>::deep_copy(from, [this](node_ptr source, node_ptr)
+			{
+				node_ptr node = allocator_traits::allocate(_alloc, 1);
+				allocator_traits::construct(_alloc, node, *source);
+				return node;
+			});
+		}
+
+		static size_t _size(const node_ptr node) noexcept
+		{
+			return node == nullptr ? 0 : node->sub_tree_size;
+		}
+
+		// recomputes size and summary of node from its children, children must not have pending updates of node
+		static void _update(node_ptr node)
+		{
+			node->sub_tree_size = 1 + _size(node->left) + _size(node->right);
+			summary_type summary = Summary::summarize(node->value);
+			if (node->left != nullptr) summary = Summary::combine(node->left->summary, summary);
+			if (node->right != nullptr) summary = Summary::combine(summary, node->right->summary);
+			node->summary = summary;
+		}
+
+		// applies update to the whole subtree of node: node value and summary are updated now, children later
+		static void _apply_update(node_ptr node, const update_type& update)
+		{
+			if constexpr (has_update)
+			{
+				Summary::apply(node->value, node->summary, update, node->sub_tree_size);
+				node->pending = node->has_pending ? Summary::compose(node->pending, update) : update;
+				node->has_pending = true;
+			}
+		}
+
+		// reverses subtree of node: children of node are swapped now, their subtrees later
+		static void _apply_reverse(node_ptr node)
+		{
+			std::swap(node->left, node->right);
+			node->reversed = !node->reversed;
+			if constexpr (treap_has_reverse<Summary>::value)
+			{
+				Summary::reverse(node->summary);
+			}
+		}
+
+		// pushes pending operations of node to its children
+		static void _push(node_ptr node)
+		{
+			if (node->has_pending)
+			{
+				if (node->left != nullptr) _apply_update(node->left, node->pending);
+				if (node->right != nullptr) _apply_update(node->right, node->pending);
+				node->pending = update_type();
+				node->has_pending = false;
+			}
+			if (node->reversed)
+			{
+				if (node->left != nullptr) _apply_reverse(node->left);
+				if (node->right != nullptr) _apply_reverse(node->right);
+				node->reversed = false;
+			}
+		}
+
+		// updates nodes pushed to _path after [base] in reverse order, so children are always updated before parents
+		void _update_path(size_t base)
+		{
+			while (_path.size() > base)
+			{
+				_update(_path.back());
+				_path.pop_back();
+			}
+		}
+
+		/*
+		splits tree into first [count] elements and the rest. Top-down as treap::_split: nodes are linked into
+		[hook] slots of the two trees while descending, pending operations are pushed on the way
+		*/
+		node_ptr_pair _split(node_ptr root, size_t count)
+		{
+			const size_t base = _path.size();
+			node_ptr tree_left = nullptr, tree_right = nullptr;
+			node_ptr* left_hook = &tree_left;
+			node_ptr* right_hook = &tree_right;
+			while (root != nullptr)
+			{
+				_push(root);
+				_path.push_back(root);
+				size_t left_size = _size(root->left);
+				if (count <= left_size)
+				{
+					*right_hook = root;
+					right_hook = &root->left;
+					root = root->left;
+				}
+				else
+				{
+					count -= left_size + 1;
+					*left_hook = root;
+					left_hook = &root->right;
+					root = root->right;
+				}
+			}
+			*left_hook = nullptr;
+			*right_hook = nullptr;
+			_update_path(base);
+			return { tree_left, tree_right };
+		}
+
+		node_ptr _merge(node_ptr tree_left, node_ptr tree_right)
+		{
+			const size_t base = _path.size();
+			node_ptr root = nullptr;
+			node_ptr* hook = &root;
+			while (tree_left != nullptr && tree_right != nullptr)
+			{
+				if (tree_left->priority < tree_right->priority)
+				{
+					_push(tree_left);
+					*hook = tree_left;
+					_path.push_back(tree_left);
+					hook = &tree_left->right;
+					tree_left = tree_left->right;
+				}
+				else
+				{
+					_push(tree_right);
+					*hook = tree_right;
+					_path.push_back(tree_right);
+					hook = &tree_right->left;
+					tree_right = tree_right->left;
+				}
+			}
+			*hook = (tree_left != nullptr) ? tree_left : tree_right;
+			_update_path(base);
+			return root;
+		}
+
+		// node at [index], pending operations on the path are pushed so node value is up to date
+		node_ptr _nth(size_t index)
+		{
+			node_ptr node = _root;
+			while (true)
+			{
+				_push(node);
+				size_t left_size = _size(node->left);
+				if (index < left_size)
+				{
+					node = node->left;
+				}
+				else if (index == left_size)
+				{
+					return node;
+				}
+				else
+				{
+					index -= left_size + 1;
+					node = node->right;
+				}
+			}
+		}
+
+		/*
+		in-order traversal which does not change nodes: pending reverse and update of ancestors are carried down
+		the explicit stack instead of being pushed, values with pending update are passed to func as updated copies
+		*/
+		template<typename Func>
+		void _apply(Func&& func) const
+		{
+			struct frame
+			{
+				node_ptr node;
+				bool reversed; // pending reverse of ancestors
+				bool has_pending;
+				update_type pending; // pending update of ancestors
+				bool visit; // children are already on the stack
+			};
+			std::vector<frame> st;
+			if (_root != nullptr) st.push_back(frame{ _root, false, false, update_type(), false });
+			while (!st.empty())
+			{
+				frame current = st.back();
+				st.pop_back();
+				const node_ptr node = current.node;
+				if (current.visit)
+				{
+					if constexpr (has_update)
+					{
+						if (current.has_pending)
+						{
+							value_type value = node->value;
+							summary_type summary = node->summary;
+							Summary::apply(value, summary, current.pending, 1);
+							func(static_cast<const value_type&>(value));
+							continue;
+						}
+					}
+					func(static_cast<const value_type&>(node->value));
+					continue;
+				}
+				frame child = current;
+				child.reversed = current.reversed != node->reversed;
+				if constexpr (has_update)
+				{
+					// node pending update is older than updates of its ancestors
+					if (node->has_pending)
+					{
+						child.pending = current.has_pending ? Summary::compose(node->pending, current.pending) : node->pending;
+						child.has_pending = true;
+					}
+				}
+				node_ptr first = current.reversed ? node->right : node->left;
+				node_ptr second = current.reversed ? node->left : node->right;
+				if (second != nullptr)
+				{
+					child.node = second;
+					st.push_back(child);
+				}
+				current.visit = true;
+				st.push_back(current);
+				if (first != nullptr)
+				{
+					child.node = first;
+					st.push_back(child);
+				}
+			}
+		}
+
+		// linear-time build with stack of the right spine, same as treap::_build
+		template<typename It>
+		node_ptr _build(It first, It last)
+		{
+			std::vector<node_ptr> st;
+			node_ptr root = nullptr;
+
+			for (It it = first; it != last; it++)
+			{
+				node_ptr current = _construct_node(*it);
+				node_ptr last_popped = nullptr;
+
+				while (!st.empty())
+				{
+					if (st.back()->priority < current->priority)
+					{
+						st.back()->right = current;
+						break;
+					}
+					last_popped = st.back();
+					_update(last_popped);
+					st.pop_back();
+				}
+				if (st.empty())
+					root = current;
+
+				current->left = last_popped;
+				st.push_back(current);
+			}
+			while (!st.empty())
+			{
+				_update(st.back());
+				st.pop_back();
+			}
+			return root;
+		}
+
+		/*
+		calls func(middle) with subtree of [first; last) cut out of the tree and puts it back.
+		subtree root is nullptr if range is empty
+		*/
+		template<typename Func>
+		void _with_range(size_t first, size_t last, Func&& func)
+		{
+			auto right = _split(_root, last);
+			auto left = _split(right.first, first);
+			func(left.second);
+			_root = _merge(_merge(left.first, left.second), right.second);
+		}
+	public:
+		implicit_treap() = default;
+
+		// elements are stored in the order of [first; last)
+		template<typename It>
+		implicit_treap(It first, It last)
+		{
+			_root = _build(first, last);
+		}
+
+		implicit_treap(const implicit_treap& tr)
+			: _alloc(tr._alloc)
+		{
+			_root = _deep_copy(tr._root);
+		}
+
+		implicit_treap(implicit_treap&& tr) noexcept
+			: _root(tr._root), _alloc(std::move(tr._alloc))
+		{
+			tr._root = nullptr;
+		}
+
+		implicit_treap& operator=(const implicit_treap& tr)
+		{
+			if (this != &tr)
+			{
+				implicit_treap copy(tr);
+				swap(copy);
+			}
+			return *this;
+		}
+
+		implicit_treap& operator=(implicit_treap&& tr) noexcept
+		{
+			if (this != &tr)
+			{
+				clear();
+				std::swap(_root, tr._root);
+				_alloc = std::move(tr._alloc);
+			}
+			return *this;
+		}
+
+		~implicit_treap()
+		{
+			clear();
+		}
+
+		void swap(implicit_treap& tr) noexcept
+		{
+			std::swap(_root, tr._root);
+			std::swap(_alloc, tr._alloc);
+		}
+
+		size_t size() const noexcept
+		{
+			return _size(_root);
+		}
+
+		bool empty() const noexcept
+		{
+			return _root == nullptr;
+		}
+
+		size_t max_size() const noexcept
+		{
+			return std::numeric_limits<size_t>::max();
+		}
+
+		void clear() noexcept
+		{
+			if (_root != nullptr)
+			{
+				_destroy_tree(_root);
+				_root = nullptr;
+			}
+		}
+
+		// inserts value before element at [index], index greater than size() inserts to the end
+		template<typename U>
+		void insert_at(size_t index, U&& value)
+		{
+			auto subTree = _split(_root, index);
+			_root = _merge(_merge(subTree.first, _construct_node(std::forward<U>(value))), subTree.second);
+		}
+
+		template<typename U>
+		void push_back(U&& value)
+		{
+			_root = _merge(_root, _construct_node(std::forward<U>(value)));
+		}
+
+		template<typename U>
+		void push_front(U&& value)
+		{
+			_root = _merge(_construct_node(std::forward<U>(value)), _root);
+		}
+
+		// erases elements in [first; last)
+		void erase(size_t first, size_t last)
+		{
+			if (first >= last) return;
+			_with_range(first, last, [this](node_ptr& middle)
+			{
+				_destroy_tree(middle);
+				middle = nullptr;
+			});
+		}
+
+		void erase_at(size_t index)
+		{
+			erase(index, index + 1);
+		}
+
+		/*
+		returns element at [index], index must be less than size(). Not const, as query(): pending operations
+		on the path are pushed to the nodes, so reference is to up to date value
+		*/
+		const value_type& nth(size_t index)
+		{
+			return _nth(index)->value;
+		}
+
+		const value_type& operator[](size_t index)
+		{
+			return nth(index);
+		}
+
+		void set(size_t index, const value_type& value)
+		{
+			_with_range(index, index + 1, [&value](node_ptr middle)
+			{
+				if (middle == nullptr) return;
+				middle->value = value;
+				_update(middle);
+			});
+		}
+
+		/*
+		returns summary of elements in [first; last), summary_type() if range is empty
+		*/
+		summary_type query(size_t first, size_t last)
+		{
+			summary_type res = summary_type();
+			if (first >= last) return res;
+			_with_range(first, last, [&res](node_ptr middle)
+			{
+				if (middle != nullptr) res = middle->summary;
+			});
+			return res;
+		}
+
+		// summary of all elements, tree must not be empty
+		const summary_type& summary() const
+		{
+			return _root->summary;
+		}
+
+		/*
+		applies update to every element in [first; last) in O(log n)
+		*/
+		template<bool Enable = has_update, typename = typename std::enable_if<Enable>::type>
+		void update(size_t first, size_t last, const update_type& value)
+		{
+			if (first >= last) return;
+			_with_range(first, last, [&value](node_ptr middle)
+			{
+				if (middle != nullptr) _apply_update(middle, value);
+			});
+		}
+
+		// reverses order of elements in [first; last) in O(log n)
+		void reverse(size_t first, size_t last)
+		{
+			if (first >= last) return;
+			_with_range(first, last, [](node_ptr middle)
+			{
+				if (middle != nullptr) _apply_reverse(middle);
+			});
+		}
+
+		/*
+		splits treap into first [index] elements and the rest, treap becomes empty
+		*/
+		implicit_treap_pair split(size_t index)
+		{
+			implicit_treap_pair p;
+			node_ptr_pair sub_trees = _split(_root, index);
+			p.first._root = sub_trees.first;
+			p.first._alloc = _alloc;
+			p.second._root = sub_trees.second;
+			p.second._alloc = _alloc;
+			_root = nullptr;
+			return p; // NRVO
+		}
+
+		// appends all elements of [tr] to the end, tr becomes empty
+		void append(implicit_treap&& tr)
+		{
+			if constexpr (treap_is_pool_allocator<allocator>::value)
+			{
+				if (tr._root != nullptr) _alloc.adopt(tr._alloc);
+			}
+			_root = _merge(_root, tr._root);
+			tr._root = nullptr;
+		}
+
+		// calls func(value) for every element in order, tree is not changed, so it is safe for concurrent readers
+		template<typename Func>
+		void apply_visitor(Func&& func) const
+		{
+			_apply(func);
+		}
+	};
+
+	template<typename T, typename S, typename R, template<typename> class A>
+	inline void swap(implicit_treap<T, S, R, A>& tr1, implicit_treap<T, S, R, A>& tr2) noexcept
+	{
+		tr1.swap(tr2);
+	}
+}
@@ -6,6 +6,9 @@
 #include <initializer_list>
 #include <set>
 #include <sstream>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
 
 /*
 this is simple matrix class. I usually use it when solve 
@@ -13,12 +16,19 @@ programming contests, so you'd better install actual math library, glm for examp
 */
 namespace momo
 {
+	template<typename E>
+	class matrix_expr;
+
+	template<typename T>
+	class matrix_product;
+
 	template <typename T>
 	class matrix
 	{
 	private:
 		size_t size_x, size_y;
 	public:
+		using value_type = T;
 		std::vector<std::vector<T> > vec;
 		matrix();
 		matrix(size_t);
@@ -30,12 +40,23 @@ namespace momo
 		matrix(const std::vector<std::vector<T> >&);
 		matrix(std::initializer_list<std::initializer_list<T> >);
 		matrix(std::initializer_list<T>);
+		template<typename E>
+		matrix(const matrix_expr<E>&);
+		matrix(const matrix_product<T>&);
 		~matrix() = default;
 		size_t xsize() const;
 		size_t ysize() const;
+		T& operator()(size_t, size_t);
+		const T& operator()(size_t, size_t) const;
 		std::vector<std::vector<T> > getVectorCopy() const;
 		matrix<T>& operator=(const matrix<T>&);
+		matrix<T>& operator=(matrix<T>&&) noexcept;
 		matrix<T>& operator=(const std::vector<std::vector<T> >&);
+		template<typename E>
+		matrix<T>& operator=(const matrix_expr<E>&);
+		matrix<T>& operator=(const matrix_product<T>&);
+		void swap(matrix<T>&) noexcept;
+		static matrix<T> identity(size_t);
 		bool operator==(const matrix<T>&) const;
 		bool operator!=(const matrix<T>&) const;
 		matrix<T>& operator+=(const matrix<T>&);
@@ -45,36 +66,25 @@ namespace momo
 		matrix<T>& operator-=(T);
 		matrix<T>& operator*=(T);
 		matrix<T>& operator/=(T);
-		matrix<T> operator+(const matrix<T>&) const;
-		matrix<T> operator-(const matrix<T>&) const;
-		matrix<T> operator*(const matrix<T>&) const;
-		matrix<T> operator+(T) const;
-		matrix<T> operator-(T) const;
-		matrix<T> operator*(T) const;
-		matrix<T> operator/(T) const;
+		template<typename E>
+		matrix<T>& operator+=(const matrix_expr<E>&);
+		template<typename E>
+		matrix<T>& operator-=(const matrix_expr<E>&);
+		matrix<T>& operator+=(const matrix_product<T>&);
+		matrix<T>& operator-=(const matrix_product<T>&);
 
 		template<typename U>
 		friend matrix<U> mult(const matrix<U>&, const matrix<U>&, U mod);
 	};
 
+	// tile size of blocked multiplication kernel (in elements)
+	constexpr size_t matrix_block_size = 64;
+
 	template<typename T>
-	matrix<T> pow(const matrix<T>& M, long long power) {
-		if (power == 1)
-		{
-			return M;
-		}
-		else if (power == 2)
-		{
-			return M * M;
-		}
+	void mult_into(const matrix<T>& M1, const matrix<T>& M2, matrix<T>& res);
 
-		if (power % 2 == 1)
-			return pow(M, power - 1) * M;
-		else {
-			auto TMP = pow(M, power / 2);
-			return TMP * TMP;
-		}
-	}
+	template<typename T>
+	void mult_into(const matrix<T>& M1, const matrix<T>& M2, matrix<T>& res, T mod);
 
 	template<typename T>
 	std::ostream& operator<<(std::ostream& os, const matrix<T>& M)
@@ -90,20 +100,6 @@ namespace momo
 		return os;
 	}
 
-	template<typename T>
-	matrix<T> operator*(T value, const matrix<T>& M)
-	{
-		matrix<T> res(M.xsize(), M.ysize());
-		for (size_t i = 0; i < res.xsize(); i++)
-		{
-			for (size_t j = 0; j < res.ysize(); j++)
-			{
-				res.vec[i][j] = value * M.vec[i][j];
-			}
-		}
-		return res;
-	}
-
 	template<typename T>
 	matrix<T>::matrix()
 		: size_x(0), size_y(0) { }
@@ -176,6 +172,18 @@ namespace momo
 		return size_y;
 	}
 
+	template<typename T>
+	T& matrix<T>::operator()(size_t i, size_t j)
+	{
+		return vec[i][j];
+	}
+
+	template<typename T>
+	const T& matrix<T>::operator()(size_t i, size_t j) const
+	{
+		return vec[i][j];
+	}
+
 	template<typename T>
 	std::vector<std::vector<T> > matrix<T>::getVectorCopy() const
 	{
@@ -191,6 +199,40 @@ namespace momo
 		return *this;
 	}
 
+	template<typename T>
+	matrix<T>& matrix<T>::operator=(matrix<T>&& src) noexcept
+	{
+		size_x = src.size_x;
+		size_y = src.size_y;
+		vec = std::move(src.vec);
+		return *this;
+	}
+
+	template<typename T>
+	void matrix<T>::swap(matrix<T>& M) noexcept
+	{
+		std::swap(size_x, M.size_x);
+		std::swap(size_y, M.size_y);
+		vec.swap(M.vec);
+	}
+
+	template<typename T>
+	void swap(matrix<T>& M1, matrix<T>& M2) noexcept
+	{
+		M1.swap(M2);
+	}
+
+	template<typename T>
+	matrix<T> matrix<T>::identity(size_t size)
+	{
+		matrix<T> res(size);
+		for (size_t i = 0; i < size; i++)
+		{
+			res.vec[i][i] = T(1);
+		}
+		return res;
+	}
+
 	template<typename T>
 	matrix<T>& matrix<T>::operator=(const std::vector<std::vector<T> >& src)
 	{
@@ -266,22 +308,6 @@ namespace momo
 		return *this;
 	}
 
-	template<typename T>
-	matrix<T> matrix<T>::operator+(const matrix<T>& M) const
-	{
-		matrix<T> res = *this;
-		res += M;
-		return res;
-	}
-
-	template<typename T>
-	matrix<T> matrix<T>::operator-(const matrix<T>& M) const
-	{
-		matrix<T> res = *this;
-		res -= M;
-		return res;
-	}
-
 	template<typename T>
 	matrix<T>& matrix<T>::operator*=(const matrix<T>& M)
 	{
@@ -290,148 +316,1100 @@ namespace momo
 	}
 
 	template<typename T>
-	matrix<T> matrix<T>::operator+(T value) const
+	matrix<T>& matrix<T>::operator*=(T value)
 	{
-		matrix<T> res(size_x, size_y);
 		for (size_t i = 0; i < size_x; i++)
 		{
 			for (size_t j = 0; j < size_y; j++)
 			{
-				res.vec[i][j] = vec[i][j] + value;
+				vec[i][j] = value * vec[i][j];
 			}
 		}
-		return res;
+		return *this;
 	}
 
 	template<typename T>
-	matrix<T> matrix<T>::operator-(T value) const
+	matrix<T>& matrix<T>::operator/=(T value)
 	{
-		matrix<T> res(size_x, size_y);
 		for (size_t i = 0; i < size_x; i++)
 		{
 			for (size_t j = 0; j < size_y; j++)
 			{
-				res.vec[i][j] = vec[i][j] - value;
+				vec[i][j] = vec[i][j] / value;
 			}
-		}
-		return res;
+		} // no check for devision-by-zero
+		return *this;
 	}
 
-	template<typename T>
-	matrix<T> matrix<T>::operator*(T value) const
+	template<typename U>
+	matrix<U> mult(const matrix<U>& M1, const matrix<U>& M2, U mod)
 	{
-		matrix<T> res(size_x, size_y);
-		for (size_t i = 0; i < size_x; i++)
+		if (M1.size_y != M2.size_x)
 		{
-			for (size_t j = 0; j < size_y; j++)
-			{
-				res.vec[i][j] = vec[i][j] * value;
-			}
+			return matrix<U>(1, 1);
 		}
+		matrix<U> res(M1.size_x, M2.size_y);
+		mult_into(M1, M2, res, mod);
 		return res;
 	}
 
-	template<typename T>
-	matrix<T> matrix<T>::operator/(T value) const
+	/*
+	res += M1 * M2 (or res -= M1 * M2 if Subtract is set). res must be M1.xsize() x M2.ysize() and must not alias M1 or M2.
+	loops are ordered i-k-j and tiled by matrix_block_size, so a tile of M2 stays in cache while every row of M1 passes over it
+	*/
+	template<bool Subtract, typename T>
+	void _mult_accumulate(const matrix<T>& M1, const matrix<T>& M2, matrix<T>& res)
 	{
-		matrix<T> res(size_x, size_y);
-		for (size_t i = 0; i < size_x; i++)
+		const size_t n = M1.xsize(), m = M1.ysize(), p = M2.ysize();
+		for (size_t kk = 0; kk < m; kk += matrix_block_size)
 		{
-			for (size_t j = 0; j < size_y; j++)
+			const size_t kend = std::min(kk + matrix_block_size, m);
+			for (size_t jj = 0; jj < p; jj += matrix_block_size)
 			{
-				res.vec[i][j] = vec[i][j] / value;
+				const size_t jend = std::min(jj + matrix_block_size, p);
+				for (size_t i = 0; i < n; i++)
+				{
+					std::vector<T>& row = res.vec[i];
+					for (size_t k = kk; k < kend; k++)
+					{
+						const T& a = M1.vec[i][k];
+						const std::vector<T>& other = M2.vec[k];
+						for (size_t j = jj; j < jend; j++)
+						{
+							if (Subtract)
+								row[j] -= a * other[j];
+							else
+								row[j] += a * other[j];
+						}
+					}
+				}
 			}
-		} // no check for devision-by-zero
-		return res;
+		}
 	}
 
+	/*
+	computes M1 * M2 into preallocated res (res must be M1.xsize() x M2.ysize() and must not alias M1 or M2)
+	*/
 	template<typename T>
-	matrix<T>& matrix<T>::operator*=(T value)
+	void mult_into(const matrix<T>& M1, const matrix<T>& M2, matrix<T>& res)
 	{
-		for (size_t i = 0; i < size_x; i++)
+		for (size_t i = 0; i < M1.xsize(); i++)
 		{
-			for (size_t j = 0; j < size_y; j++)
-			{
-				vec[i][j] = value * vec[i][j];
-			}
+			std::fill(res.vec[i].begin(), res.vec[i].end(), T());
 		}
-		return *this;
+		_mult_accumulate<false>(M1, M2, res);
 	}
 
+	/*
+	computes res += M1 * M2 without temporary matrix (GEMM accumulate), same requirements as mult_into
+	*/
 	template<typename T>
-	matrix<T>& matrix<T>::operator/=(T value)
+	void mult_add_into(const matrix<T>& M1, const matrix<T>& M2, matrix<T>& res)
 	{
-		for (size_t i = 0; i < size_x; i++)
-		{
-			for (size_t j = 0; j < size_y; j++)
-			{
-				vec[i][j] = vec[i][j] / value;
-			}
-		} // no check for devision-by-zero
+		_mult_accumulate<false>(M1, M2, res);
 	}
 
 	template<typename T>
-	matrix<T> matrix<T>::operator*(const matrix<T>& M) const
+	void mult_into(const matrix<T>& M1, const matrix<T>& M2, matrix<T>& res, T mod)
 	{
-		if (this->size_y != M.size_x)
+		const size_t n = M1.xsize(), m = M1.ysize(), p = M2.ysize();
+		for (size_t i = 0; i < n; i++)
 		{
-			return matrix<T>(1, 1);
+			std::fill(res.vec[i].begin(), res.vec[i].end(), T());
 		}
-		matrix<T> res(this->size_x, M.size_y);
-		for (size_t i = 0; i < res.xsize(); i++)
+		for (size_t kk = 0; kk < m; kk += matrix_block_size)
 		{
-			for (size_t j = 0; j < res.ysize(); j++)
+			const size_t kend = std::min(kk + matrix_block_size, m);
+			for (size_t jj = 0; jj < p; jj += matrix_block_size)
 			{
-				res.vec[i][j] = T();
-				for (size_t k = 0; k < this->size_y; k++)
+				const size_t jend = std::min(jj + matrix_block_size, p);
+				for (size_t i = 0; i < n; i++)
 				{
-					res.vec[i][j] += vec[i][k] * M.vec[k][j];
+					std::vector<T>& row = res.vec[i];
+					for (size_t k = kk; k < kend; k++)
+					{
+						const T& a = M1.vec[i][k];
+						if (a == T()) continue;
+						const std::vector<T>& other = M2.vec[k];
+						for (size_t j = jj; j < jend; j++)
+						{
+							row[j] += a * other[j] % mod;
+							row[j] %= mod;
+						}
+					}
 				}
 			}
 		}
-		return res;
 	}
 
-	template<typename U>
-	matrix<U> mult(const matrix<U>& M1, const matrix<U>& M2, U mod)
+	/*
+	expression templates. Elementwise operators (+, - between matrices, +, -, *, / with scalar) do not compute anything,
+	they return lightweight expression objects which remember operands. Whole expression is evaluated in one pass
+	when it is assigned to matrix, so A + B * c - D allocates only the result (and nothing at all with =, += or -=).
+	Product of two matrices returns matrix_product: C = A * B writes directly into C, C += A * B accumulates into C.
+	Named matrices are captured by reference and temporary ones are moved into expression, so expression stored in auto
+	variable is valid as long as named matrices it uses are alive
+	*/
+	template<typename E>
+	class matrix_expr
 	{
-		if (M1.size_y != M2.size_x)
+	public:
+		const E& self() const
 		{
-			return matrix<U>(1, 1);
+			return static_cast<const E&>(*this);
 		}
-		matrix<U> res(M1.size_x, M2.size_y);
-		for (size_t i = 0; i < res.xsize(); i++)
+
+		size_t xsize() const
 		{
-			for (size_t j = 0; j < res.ysize(); j++)
-			{
-				res.vec[i][j] = U();
-				for (size_t k = 0; k < M1.size_y; k++)
-				{
-					res.vec[i][j] += M1.vec[i][k] * M2.vec[k][j] % mod;
-					res.vec[i][j] %= mod;
-				}
-			}
+			return self().xsize();
 		}
-		return res;
-	}
 
+		size_t ysize() const
+		{
+			return self().ysize();
+		}
+
+		auto eval() const
+		{
+			return matrix<typename E::value_type>(*this);
+		}
+	};
+
+	// leaf of expression: reference to existing matrix
+	template<typename T>
+	class matrix_ref : public matrix_expr<matrix_ref<T> >
+	{
+		const matrix<T>& _m;
+	public:
+		using value_type = T;
+
+		explicit matrix_ref(const matrix<T>& m)
+			: _m(m) { }
+
+		size_t xsize() const
+		{
+			return _m.xsize();
+		}
+
+		size_t ysize() const
+		{
+			return _m.ysize();
+		}
+
+		const T& operator()(size_t i, size_t j) const
+		{
+			return _m.vec[i][j];
+		}
+	};
+
+	// leaf of expression: owned matrix (evaluated product used inside of elementwise expression)
+	template<typename T>
+	class matrix_temp : public matrix_expr<matrix_temp<T> >
+	{
+		matrix<T> _m;
+	public:
+		using value_type = T;
+
+		explicit matrix_temp(matrix<T>&& m)
+			: _m(std::move(m)) { }
+
+		size_t xsize() const
+		{
+			return _m.xsize();
+		}
+
+		size_t ysize() const
+		{
+			return _m.ysize();
+		}
+
+		const T& operator()(size_t i, size_t j) const
+		{
+			return _m.vec[i][j];
+		}
+	};
+
+	struct _expr_add
+	{
+		template<typename T> static T apply(const T& a, const T& b) { return a + b; }
+	};
+
+	struct _expr_sub
+	{
+		template<typename T> static T apply(const T& a, const T& b) { return a - b; }
+	};
+
+	struct _expr_mul
+	{
+		template<typename T> static T apply(const T& a, const T& b) { return a * b; }
+	};
+
+	struct _expr_div
+	{
+		template<typename T> static T apply(const T& a, const T& b) { return a / b; }
+	};
+
+	// value * element, T multiplication is not required to be commutative
+	struct _expr_rmul
+	{
+		template<typename T> static T apply(const T& a, const T& b) { return b * a; }
+	};
+
+	/*
+	elementwise operation of two expressions. As operator+= does, leaves left operand unchanged if sizes do not match
+	*/
+	template<typename L, typename R, typename Op>
+	class matrix_binary_expr : public matrix_expr<matrix_binary_expr<L, R, Op> >
+	{
+		L _l;
+		R _r;
+		bool _conformable;
+	public:
+		using value_type = typename L::value_type;
+
+		matrix_binary_expr(L l, R r)
+			: _l(std::move(l)), _r(std::move(r)), _conformable(_l.xsize() == _r.xsize() && _l.ysize() == _r.ysize()) { }
+
+		size_t xsize() const
+		{
+			return _l.xsize();
+		}
+
+		size_t ysize() const
+		{
+			return _l.ysize();
+		}
+
+		value_type operator()(size_t i, size_t j) const
+		{
+			return _conformable ? Op::apply(_l(i, j), _r(i, j)) : _l(i, j);
+		}
+	};
+
+	template<typename E, typename Op>
+	class matrix_scalar_expr : public matrix_expr<matrix_scalar_expr<E, Op> >
+	{
+	public:
+		using value_type = typename E::value_type;
+	private:
+		E _e;
+		value_type _value;
+	public:
+		matrix_scalar_expr(E e, value_type value)
+			: _e(std::move(e)), _value(std::move(value)) { }
+
+		size_t xsize() const
+		{
+			return _e.xsize();
+		}
+
+		size_t ysize() const
+		{
+			return _e.ysize();
+		}
+
+		value_type operator()(size_t i, size_t j) const
+		{
+			return Op::apply(_e(i, j), _value);
+		}
+	};
+
+	/*
+	true if element (i, j) of expression reads only elements (i, j) of its leaves, so expression can be evaluated
+	directly into matrix which is one of its leaves. Leaves which can read other elements of the same matrix
+	(transposed or shifted views of matrix_view.h) set it to false and expression is evaluated into temporary
+	*/
+	template<typename E>
+	struct matrix_expr_in_place : std::true_type { };
+
+	template<typename L, typename R, typename Op>
+	struct matrix_expr_in_place<matrix_binary_expr<L, R, Op> >
+		: std::integral_constant<bool, matrix_expr_in_place<L>::value && matrix_expr_in_place<R>::value> { };
+
+	template<typename E, typename Op>
+	struct matrix_expr_in_place<matrix_scalar_expr<E, Op> > : matrix_expr_in_place<E> { };
+
+	/*
+	lazy product of two matrices. Operands which are not plain matrices are evaluated once and owned by product.
+	product points to its own members, so it can not be copied (guaranteed copy elision is enough to return it)
+	*/
 	template<typename T>
-	matrix<T> pow(const matrix<T>& M, long long power, T mod) {
-		if (power == 1)
+	class matrix_product
+	{
+		matrix<T> _owned_a, _owned_b;
+		const matrix<T>* _a;
+		const matrix<T>* _b;
+	public:
+		using value_type = T;
+
+		matrix_product(const matrix<T>* a, const matrix<T>* b, matrix<T> owned_a = matrix<T>(), matrix<T> owned_b = matrix<T>())
+			: _owned_a(std::move(owned_a)), _owned_b(std::move(owned_b)), _a(a != nullptr ? a : &_owned_a), _b(b != nullptr ? b : &_owned_b) { }
+
+		matrix_product(const matrix_product&) = delete;
+		matrix_product& operator=(const matrix_product&) = delete;
+
+		const matrix<T>& left() const
+		{
+			return *_a;
+		}
+
+		const matrix<T>& right() const
+		{
+			return *_b;
+		}
+
+		bool conformable() const
+		{
+			return _a->ysize() == _b->xsize();
+		}
+
+		// product of non-conformable matrices is 1x1 zero matrix
+		size_t xsize() const
+		{
+			return conformable() ? _a->xsize() : 1;
+		}
+
+		size_t ysize() const
 		{
-			return M;
+			return conformable() ? _b->ysize() : 1;
 		}
-		else if (power == 2)
+
+		bool aliases(const matrix<T>& M) const
 		{
-			return mult(M, M, mod);
+			return _a == &M || _b == &M;
 		}
 
-		if (power % 2 == 1)
-			return mult(M, pow(M, power - 1, mod), mod);
-		else 
+		// res must be xsize() x ysize() and must not be one of operands
+		void eval_into(matrix<T>& res) const
 		{
-			auto X = mult(M, M, mod);
-			return pow(X, power / 2, mod);
+			if (conformable())
+				mult_into(*_a, *_b, res);
+			else
+				res.vec[0][0] = T();
 		}
+	};
+
+	template<typename X>
+	struct is_matrix_expr : std::is_base_of<matrix_expr<X>, X> { };
+
+	template<typename X>
+	struct is_matrix_operand : is_matrix_expr<X> { };
+
+	template<typename T>
+	struct is_matrix_operand<matrix<T> > : std::true_type { };
+
+	template<typename T>
+	struct is_matrix_operand<matrix_product<T> > : std::true_type { };
+
+	template<typename... Xs>
+	using enable_if_matrix_operands = typename std::enable_if<(is_matrix_operand<typename std::decay<Xs>::type>::value && ...)>::type;
+
+	// turns operand into expression node: matrix -> matrix_ref, temporary matrix or product -> matrix_temp, expression -> itself
+	template<typename T>
+	matrix_ref<T> _as_expr(const matrix<T>& M)
+	{
+		return matrix_ref<T>(M);
+	}
+
+	template<typename T>
+	matrix_temp<T> _as_expr(matrix<T>&& M)
+	{
+		return matrix_temp<T>(std::move(M));
+	}
+
+	template<typename T>
+	matrix_temp<T> _as_expr(const matrix_product<T>& P)
+	{
+		return matrix_temp<T>(matrix<T>(P));
+	}
+
+	template<typename E>
+	E _as_expr(const matrix_expr<E>& e)
+	{
+		return e.self();
+	}
+
+	template<typename E>
+	E _as_expr(matrix_expr<E>&& e)
+	{
+		return std::move(static_cast<E&>(e));
+	}
+
+	template<typename X>
+	using _expr_t = decltype(_as_expr(std::declval<X>()));
+
+	// turns operand into matrix for product: named matrix is referenced, temporary is moved and anything else is evaluated into [owned]
+	template<typename T>
+	const matrix<T>* _product_operand(const matrix<T>& M, matrix<T>&)
+	{
+		return &M;
+	}
+
+	template<typename T>
+	const matrix<T>* _product_operand(matrix<T>&& M, matrix<T>& owned)
+	{
+		owned = std::move(M);
+		return nullptr;
+	}
+
+	template<typename X>
+	const matrix<typename X::value_type>* _product_operand(const X& x, matrix<typename X::value_type>& owned)
+	{
+		owned = matrix<typename X::value_type>(x);
+		return nullptr;
+	}
+
+	template<typename X, typename Y, typename = enable_if_matrix_operands<X, Y> >
+	matrix_binary_expr<_expr_t<X>, _expr_t<Y>, _expr_add> operator+(X&& M1, Y&& M2)
+	{
+		return matrix_binary_expr<_expr_t<X>, _expr_t<Y>, _expr_add>(_as_expr(std::forward<X>(M1)), _as_expr(std::forward<Y>(M2)));
+	}
+
+	template<typename X, typename Y, typename = enable_if_matrix_operands<X, Y> >
+	matrix_binary_expr<_expr_t<X>, _expr_t<Y>, _expr_sub> operator-(X&& M1, Y&& M2)
+	{
+		return matrix_binary_expr<_expr_t<X>, _expr_t<Y>, _expr_sub>(_as_expr(std::forward<X>(M1)), _as_expr(std::forward<Y>(M2)));
+	}
+
+	template<typename X, typename = enable_if_matrix_operands<X> >
+	matrix_scalar_expr<_expr_t<X>, _expr_add> operator+(X&& M, const typename std::decay<X>::type::value_type& value)
+	{
+		return matrix_scalar_expr<_expr_t<X>, _expr_add>(_as_expr(std::forward<X>(M)), value);
+	}
+
+	template<typename X, typename = enable_if_matrix_operands<X> >
+	matrix_scalar_expr<_expr_t<X>, _expr_sub> operator-(X&& M, const typename std::decay<X>::type::value_type& value)
+	{
+		return matrix_scalar_expr<_expr_t<X>, _expr_sub>(_as_expr(std::forward<X>(M)), value);
+	}
+
+	template<typename X, typename = enable_if_matrix_operands<X> >
+	matrix_scalar_expr<_expr_t<X>, _expr_mul> operator*(X&& M, const typename std::decay<X>::type::value_type& value)
+	{
+		return matrix_scalar_expr<_expr_t<X>, _expr_mul>(_as_expr(std::forward<X>(M)), value);
+	}
+
+	template<typename X, typename = enable_if_matrix_operands<X> >
+	matrix_scalar_expr<_expr_t<X>, _expr_rmul> operator*(const typename std::decay<X>::type::value_type& value, X&& M)
+	{
+		return matrix_scalar_expr<_expr_t<X>, _expr_rmul>(_as_expr(std::forward<X>(M)), value);
+	}
+
+	template<typename X, typename = enable_if_matrix_operands<X> >
+	matrix_scalar_expr<_expr_t<X>, _expr_div> operator/(X&& M, const typename std::decay<X>::type::value_type& value)
+	{
+		return matrix_scalar_expr<_expr_t<X>, _expr_div>(_as_expr(std::forward<X>(M)), value); // no check for devision-by-zero
+	}
+
+	template<typename X, typename Y, typename = enable_if_matrix_operands<X, Y> >
+	matrix_product<typename std::decay<X>::type::value_type> operator*(X&& M1, Y&& M2)
+	{
+		using T = typename std::decay<X>::type::value_type;
+		matrix<T> owned_a, owned_b;
+		const matrix<T>* a = _product_operand(std::forward<X>(M1), owned_a);
+		const matrix<T>* b = _product_operand(std::forward<Y>(M2), owned_b);
+		return matrix_product<T>(a, b, std::move(owned_a), std::move(owned_b));
+	}
+
+	template<typename X>
+	struct _is_matrix : std::false_type { };
+
+	template<typename T>
+	struct _is_matrix<matrix<T> > : std::true_type { };
+
+	// comparison of expressions evaluates them, matrix == matrix is still member operator
+	template<typename X, typename Y>
+	using enable_if_expr_comparison = typename std::enable_if<is_matrix_operand<X>::value && is_matrix_operand<Y>::value &&
+		!(_is_matrix<X>::value && _is_matrix<Y>::value), bool>::type;
+
+	template<typename X, typename Y>
+	enable_if_expr_comparison<X, Y> operator==(const X& M1, const Y& M2)
+	{
+		using T = typename X::value_type;
+		return matrix<T>(M1) == matrix<T>(M2);
+	}
+
+	template<typename X, typename Y>
+	enable_if_expr_comparison<X, Y> operator!=(const X& M1, const Y& M2)
+	{
+		return !(M1 == M2);
+	}
+
+	template<typename X>
+	typename std::enable_if<is_matrix_expr<X>::value, std::ostream&>::type operator<<(std::ostream& os, const X& e)
+	{
+		return os << e.eval();
+	}
+
+	template<typename T>
+	std::ostream& operator<<(std::ostream& os, const matrix_product<T>& P)
+	{
+		return os << matrix<T>(P);
+	}
+
+	template<typename T>
+	template<typename E>
+	matrix<T>::matrix(const matrix_expr<E>& e)
+		: size_x(e.xsize()), size_y(e.ysize()), vec(e.xsize(), std::vector<T>(e.ysize()))
+	{
+		const E& expr = e.self();
+		for (size_t i = 0; i < size_x; i++)
+		{
+			std::vector<T>& row = vec[i];
+			for (size_t j = 0; j < size_y; j++)
+			{
+				row[j] = expr(i, j);
+			}
+		}
+	}
+
+	template<typename T>
+	matrix<T>::matrix(const matrix_product<T>& P)
+		: matrix(P.xsize(), P.ysize())
+	{
+		P.eval_into(*this);
+	}
+
+	/*
+	expression is evaluated directly into existing storage if sizes match. Elementwise expression reads only element (i, j)
+	of its operands to produce element (i, j), so A = A + B is safe. Expressions with views (see matrix_expr_in_place)
+	are evaluated into temporary, so A = A + view(A).transposed() is safe too
+	*/
+	template<typename T>
+	template<typename E>
+	matrix<T>& matrix<T>::operator=(const matrix_expr<E>& e)
+	{
+		if (!matrix_expr_in_place<E>::value || size_x != e.xsize() || size_y != e.ysize())
+		{
+			matrix<T> res(e);
+			this->swap(res);
+			return *this;
+		}
+		const E& expr = e.self();
+		for (size_t i = 0; i < size_x; i++)
+		{
+			std::vector<T>& row = vec[i];
+			for (size_t j = 0; j < size_y; j++)
+			{
+				row[j] = expr(i, j);
+			}
+		}
+		return *this;
+	}
+
+	template<typename T>
+	matrix<T>& matrix<T>::operator=(const matrix_product<T>& P)
+	{
+		if (P.aliases(*this) || size_x != P.xsize() || size_y != P.ysize())
+		{
+			matrix<T> res(P);
+			this->swap(res);
+			return *this;
+		}
+		P.eval_into(*this);
+		return *this;
+	}
+
+	template<typename T>
+	template<typename E>
+	matrix<T>& matrix<T>::operator+=(const matrix_expr<E>& e)
+	{
+		if (size_x != e.xsize() || size_y != e.ysize()) return *this;
+		if constexpr (!matrix_expr_in_place<E>::value)
+		{
+			return *this += matrix_temp<T>(matrix<T>(e));
+		}
+		const E& expr = e.self();
+		for (size_t i = 0; i < size_x; i++)
+		{
+			std::vector<T>& row = vec[i];
+			for (size_t j = 0; j < size_y; j++)
+			{
+				row[j] += expr(i, j);
+			}
+		}
+		return *this;
+	}
+
+	template<typename T>
+	template<typename E>
+	matrix<T>& matrix<T>::operator-=(const matrix_expr<E>& e)
+	{
+		if (size_x != e.xsize() || size_y != e.ysize()) return *this;
+		if constexpr (!matrix_expr_in_place<E>::value)
+		{
+			return *this -= matrix_temp<T>(matrix<T>(e));
+		}
+		const E& expr = e.self();
+		for (size_t i = 0; i < size_x; i++)
+		{
+			std::vector<T>& row = vec[i];
+			for (size_t j = 0; j < size_y; j++)
+			{
+				row[j] -= expr(i, j);
+			}
+		}
+		return *this;
+	}
+
+	// C += A * B is GEMM accumulate, temporary is used only if C is one of operands
+	template<typename T>
+	matrix<T>& matrix<T>::operator+=(const matrix_product<T>& P)
+	{
+		if (!P.conformable() || size_x != P.xsize() || size_y != P.ysize()) return *this;
+		if (P.aliases(*this)) return *this += matrix<T>(P);
+		_mult_accumulate<false>(P.left(), P.right(), *this);
+		return *this;
+	}
+
+	template<typename T>
+	matrix<T>& matrix<T>::operator-=(const matrix_product<T>& P)
+	{
+		if (!P.conformable() || size_x != P.xsize() || size_y != P.ysize()) return *this;
+		if (P.aliases(*this)) return *this -= matrix<T>(P);
+		_mult_accumulate<true>(P.left(), P.right(), *this);
+		return *this;
+	}
+
+	/*
+	computes M * M into preallocated res. 2x2 matrices use 6 multiplications instead of 8
+	*/
+	template<typename T>
+	void square_into(const matrix<T>& M, matrix<T>& res)
+	{
+		if (M.xsize() == 2)
+		{
+			const T& a = M.vec[0][0], & b = M.vec[0][1], & c = M.vec[1][0], & d = M.vec[1][1];
+			T bc = b * c, ad = a + d;
+			res.vec[0][0] = a * a + bc;
+			res.vec[0][1] = b * ad;
+			res.vec[1][0] = c * ad;
+			res.vec[1][1] = d * d + bc;
+			return;
+		}
+		mult_into(M, M, res);
+	}
+
+	template<typename T>
+	void square_into(const matrix<T>& M, matrix<T>& res, T mod)
+	{
+		if (M.xsize() == 2)
+		{
+			const T& a = M.vec[0][0], & b = M.vec[0][1], & c = M.vec[1][0], & d = M.vec[1][1];
+			T bc = b * c % mod, ad = (a + d) % mod;
+			res.vec[0][0] = (a * a % mod + bc) % mod;
+			res.vec[0][1] = b * ad % mod;
+			res.vec[1][0] = c * ad % mod;
+			res.vec[1][1] = (d * d % mod + bc) % mod;
+			return;
+		}
+		mult_into(M, M, res, mod);
+	}
+
+	/*
+	computes M * v into preallocated res (res.size() == M.xsize(), res must not alias v)
+	*/
+	template<typename T>
+	void mult_into(const matrix<T>& M, const std::vector<T>& v, std::vector<T>& res)
+	{
+		for (size_t i = 0; i < M.xsize(); i++)
+		{
+			const std::vector<T>& row = M.vec[i];
+			T sum = T();
+			for (size_t j = 0; j < M.ysize(); j++)
+			{
+				sum += row[j] * v[j];
+			}
+			res[i] = sum;
+		}
+	}
+
+	template<typename T>
+	void mult_into(const matrix<T>& M, const std::vector<T>& v, std::vector<T>& res, T mod)
+	{
+		for (size_t i = 0; i < M.xsize(); i++)
+		{
+			const std::vector<T>& row = M.vec[i];
+			T sum = T();
+			for (size_t j = 0; j < M.ysize(); j++)
+			{
+				sum += row[j] * v[j] % mod;
+				sum %= mod;
+			}
+			res[i] = sum;
+		}
+	}
+
+	/*
+	binary exponentiation without recursion. Works in three preallocated buffers (result, base and scratch)
+	which are swapped after every product, so no matrix is allocated inside the loop.
+	pow(M, 0) returns identity matrix, non-square matrix gives 1x1 matrix as operator* does
+	*/
+	template<typename T>
+	matrix<T> pow(const matrix<T>& M, long long power)
+	{
+		if (M.xsize() != M.ysize())
+		{
+			return matrix<T>(1, 1);
+		}
+		if (power <= 0)
+		{
+			return matrix<T>::identity(M.xsize());
+		}
+
+		matrix<T> base = M, tmp(M.xsize());
+		while ((power & 1) == 0) // skip multiplication by identity matrix
+		{
+			square_into(base, tmp);
+			base.swap(tmp);
+			power >>= 1;
+		}
+		matrix<T> res = base;
+		power >>= 1;
+		while (power > 0)
+		{
+			square_into(base, tmp);
+			base.swap(tmp);
+			if (power & 1)
+			{
+				mult_into(res, base, tmp);
+				res.swap(tmp);
+			}
+			power >>= 1;
+		}
+		return res;
+	}
+
+	template<typename T>
+	matrix<T> pow(const matrix<T>& M, long long power, T mod)
+	{
+		if (M.xsize() != M.ysize())
+		{
+			return matrix<T>(1, 1);
+		}
+		if (power <= 0)
+		{
+			return matrix<T>::identity(M.xsize());
+		}
+
+		matrix<T> base = M, tmp(M.xsize());
+		while ((power & 1) == 0)
+		{
+			square_into(base, tmp, mod);
+			base.swap(tmp);
+			power >>= 1;
+		}
+		matrix<T> res = base;
+		power >>= 1;
+		while (power > 0)
+		{
+			square_into(base, tmp, mod);
+			base.swap(tmp);
+			if (power & 1)
+			{
+				mult_into(res, base, tmp, mod);
+				res.swap(tmp);
+			}
+			power >>= 1;
+		}
+		return res;
+	}
+
+	/*
+	computes M^power * v without building M^power: every set bit of power costs one matrix-vector product
+	instead of a full matrix product, only squarings of M remain O(n^3). Useful for linear recurrences (Fibonacci etc.)
+	returns empty vector if M is not square or v has wrong size
+	*/
+	template<typename T>
+	std::vector<T> apply_pow(const matrix<T>& M, long long power, std::vector<T> v)
+	{
+		if (M.xsize() != M.ysize() || M.ysize() != v.size())
+		{
+			return std::vector<T>();
+		}
+		if (power <= 0) return v;
+
+		std::vector<T> vtmp(v.size());
+		matrix<T> base = M, tmp(M.xsize());
+		while (true)
+		{
+			if (power & 1)
+			{
+				mult_into(base, v, vtmp);
+				v.swap(vtmp);
+			}
+			power >>= 1;
+			if (power == 0) break;
+			square_into(base, tmp);
+			base.swap(tmp);
+		}
+		return v;
+	}
+
+	template<typename T>
+	std::vector<T> apply_pow(const matrix<T>& M, long long power, std::vector<T> v, T mod)
+	{
+		if (M.xsize() != M.ysize() || M.ysize() != v.size())
+		{
+			return std::vector<T>();
+		}
+		if (power <= 0) return v;
+
+		std::vector<T> vtmp(v.size());
+		matrix<T> base = M, tmp(M.xsize());
+		while (true)
+		{
+			if (power & 1)
+			{
+				mult_into(base, v, vtmp, mod);
+				v.swap(vtmp);
+			}
+			power >>= 1;
+			if (power == 0) break;
+			square_into(base, tmp, mod);
+			base.swap(tmp);
+		}
+		return v;
+	}
+
+	/*
+	arithmetic policies used by generic matrix algorithms (strassen, sparse products etc.)
+	plain_arithmetic uses operators of T, mod_arithmetic keeps every value in [0; mod) (operands must be in [0; mod) as well)
+	*/
+	template<typename T>
+	struct plain_arithmetic
+	{
+		T add(const T& a, const T& b) const
+		{
+			return a + b;
+		}
+
+		T sub(const T& a, const T& b) const
+		{
+			return a - b;
+		}
+
+		T mul(const T& a, const T& b) const
+		{
+			return a * b;
+		}
+
+		T div(const T& a, const T& b) const
+		{
+			return a / b;
+		}
+
+		void mult_into(const matrix<T>& M1, const matrix<T>& M2, matrix<T>& res) const
+		{
+			momo::mult_into(M1, M2, res);
+		}
+	};
+
+	template<typename T>
+	struct mod_arithmetic
+	{
+		T mod;
+
+		// never goes above mod, so there is no overflow even if a + b does not fit in T
+		T add(const T& a, const T& b) const
+		{
+			return a >= mod - b ? a - (mod - b) : a + b;
+		}
+
+		// never goes below zero, so it is correct for unsigned T
+		T sub(const T& a, const T& b) const
+		{
+			return a >= b ? a - b : a + (mod - b);
+		}
+
+		T mul(const T& a, const T& b) const
+		{
+			return a * b % mod;
+		}
+
+		/*
+		multiplicative inverse by extended Euclid algorithm, value must be coprime with mod.
+		Bezout coefficients change sign, so for unsigned T they are kept in signed type of the same size
+		(their absolute value never exceeds mod, which must fit in it)
+		*/
+		T inv(const T& value) const
+		{
+			using coefficient = typename std::conditional<std::is_integral<T>::value,
+				std::make_signed<T>, std::common_type<T> >::type::type;
+			T a = value % mod, m = mod;
+			coefficient x = coefficient(1), y = coefficient();
+			if (a < T()) a += mod;
+			while (a != T())
+			{
+				T q = m / a, t = m - q * a;
+				m = a; a = t;
+				coefficient c = y - coefficient(q) * x;
+				y = x; x = c;
+			}
+			return y < coefficient() ? T(y + coefficient(mod)) : T(y);
+		}
+
+		T div(const T& a, const T& b) const
+		{
+			return mul(a, inv(b));
+		}
+
+		void mult_into(const matrix<T>& M1, const matrix<T>& M2, matrix<T>& res) const
+		{
+			momo::mult_into(M1, M2, res, mod);
+		}
+	};
+
+	/*
+	default size below which strassen falls back to blocked kernel. Strassen saves multiplications at cost of additions,
+	so for types with expensive multiplication (big_integer, custom modular types) it pays off much earlier
+	*/
+	template<typename T>
+	constexpr size_t strassen_crossover = std::is_arithmetic<T>::value ? 128 : 16;
+
+	/*
+	tuning of strassen, [crossover] = 0 means strassen_crossover<T>. Crossover is passed in struct, so integer
+	argument of strassen is always modulus, as in mult and pow
+	*/
+	struct strassen_options
+	{
+		size_t crossover = 0;
+	};
+
+	template<typename T>
+	inline size_t _strassen_crossover(const strassen_options& options)
+	{
+		return options.crossover == 0 ? strassen_crossover<T> : options.crossover;
+	}
+
+	// copies h x h block of M starting at (row, col) into Q, cells outside of M are filled with zeros
+	template<typename T>
+	void _copy_block(const matrix<T>& M, size_t row, size_t col, size_t h, matrix<T>& Q)
+	{
+		for (size_t i = 0; i < h; i++)
+		{
+			std::vector<T>& dst = Q.vec[i];
+			if (row + i >= M.xsize())
+			{
+				std::fill(dst.begin(), dst.end(), T());
+				continue;
+			}
+			const std::vector<T>& src = M.vec[row + i];
+			for (size_t j = 0; j < h; j++)
+			{
+				dst[j] = (col + j < M.ysize()) ? src[col + j] : T();
+			}
+		}
+	}
+
+	// writes h x h block Q into M starting at (row, col), cells outside of M are dropped
+	template<typename T>
+	void _store_block(const matrix<T>& Q, size_t row, size_t col, size_t h, matrix<T>& M)
+	{
+		for (size_t i = 0; i < h && row + i < M.xsize(); i++)
+		{
+			for (size_t j = 0; j < h && col + j < M.ysize(); j++)
+			{
+				M.vec[row + i][col + j] = Q.vec[i][j];
+			}
+		}
+	}
+
+	template<typename T, typename Func>
+	void _elementwise_into(const matrix<T>& X, const matrix<T>& Y, matrix<T>& res, Func&& func)
+	{
+		for (size_t i = 0; i < res.xsize(); i++)
+		{
+			for (size_t j = 0; j < res.ysize(); j++)
+			{
+				res.vec[i][j] = func(X.vec[i][j], Y.vec[i][j]);
+			}
+		}
+	}
+
+	/*
+	Strassen-Winograd step: 7 recursive products and 15 additions per level. Odd sizes are padded with zero row/column on the fly
+	*/
+	template<typename T, typename Arithmetic>
+	void _strassen_into(const matrix<T>& A, const matrix<T>& B, matrix<T>& C, const Arithmetic& ar, size_t crossover)
+	{
+		const size_t n = A.xsize();
+		if (n <= crossover || n < 2)
+		{
+			ar.mult_into(A, B, C);
+			return;
+		}
+		const size_t h = (n + 1) / 2;
+		auto add = [&ar](const T& a, const T& b) { return ar.add(a, b); };
+		auto sub = [&ar](const T& a, const T& b) { return ar.sub(a, b); };
+
+		matrix<T> A11(h), A12(h), A21(h), A22(h), B11(h), B12(h), B21(h), B22(h);
+		_copy_block(A, 0, 0, h, A11); _copy_block(A, 0, h, h, A12);
+		_copy_block(A, h, 0, h, A21); _copy_block(A, h, h, h, A22);
+		_copy_block(B, 0, 0, h, B11); _copy_block(B, 0, h, h, B12);
+		_copy_block(B, h, 0, h, B21); _copy_block(B, h, h, h, B22);
+
+		matrix<T> S1(h), S2(h), S3(h), S4(h), T1(h), T2(h), T3(h), T4(h);
+		_elementwise_into(A21, A22, S1, add);
+		_elementwise_into(S1, A11, S2, sub);
+		_elementwise_into(A11, A21, S3, sub);
+		_elementwise_into(A12, S2, S4, sub);
+		_elementwise_into(B12, B11, T1, sub);
+		_elementwise_into(B22, T1, T2, sub);
+		_elementwise_into(B22, B12, T3, sub);
+		_elementwise_into(T2, B21, T4, sub);
+
+		matrix<T> M1(h), M2(h), M3(h), M4(h), M5(h), M6(h), M7(h);
+		_strassen_into(A11, B11, M1, ar, crossover);
+		_strassen_into(A12, B21, M2, ar, crossover);
+		_strassen_into(S4, B22, M3, ar, crossover);
+		_strassen_into(A22, T4, M4, ar, crossover);
+		_strassen_into(S1, T1, M5, ar, crossover);
+		_strassen_into(S2, T2, M6, ar, crossover);
+		_strassen_into(S3, T3, M7, ar, crossover);
+
+		// U1 = M1 + M2, U2 = M1 + M6, U3 = U2 + M7, U4 = U2 + M5, U5 = U4 + M3, U6 = U3 - M4, U7 = U3 + M5
+		// operands are reused as output buffers: M2 <- U1, M6 <- U2, M7 <- U3, M5 <- U7, M3 <- U5, M4 <- U6
+		_elementwise_into(M1, M2, M2, add);
+		_elementwise_into(M1, M6, M6, add);
+		_elementwise_into(M6, M7, M7, add);
+		_elementwise_into(M6, M5, M6, add);   // M6 = U4
+		_elementwise_into(M6, M3, M3, add);   // M3 = U5
+		_elementwise_into(M7, M4, M4, sub);   // M4 = U6
+		_elementwise_into(M7, M5, M5, add);   // M5 = U7
+
+		_store_block(M2, 0, 0, h, C);
+		_store_block(M3, 0, h, h, C);
+		_store_block(M4, h, 0, h, C);
+		_store_block(M5, h, h, h, C);
+	}
+
+	/*
+	Strassen-Winograd multiplication of square matrices, O(n^2.81) multiplications of T.
+	Intended for exact types (integers, modular integers, big_integer): floating point error grows faster than with operator*.
+	Below crossover size (see strassen_options) blocked kernel is used. Non-square matrices are multiplied with operator*
+	*/
+	template<typename T>
+	matrix<T> strassen(const matrix<T>& M1, const matrix<T>& M2, const strassen_options& options = strassen_options())
+	{
+		if (M1.xsize() != M1.ysize() || M2.xsize() != M2.ysize() || M1.ysize() != M2.xsize())
+		{
+			return M1 * M2;
+		}
+		matrix<T> res(M1.xsize());
+		_strassen_into(M1, M2, res, plain_arithmetic<T>(), _strassen_crossover<T>(options));
+		return res;
+	}
+
+	template<typename T>
+	matrix<T> strassen(const matrix<T>& M1, const matrix<T>& M2, T mod, const strassen_options& options = strassen_options())
+	{
+		if (M1.xsize() != M1.ysize() || M2.xsize() != M2.ysize() || M1.ysize() != M2.xsize())
+		{
+			return mult(M1, M2, mod);
+		}
+		matrix<T> res(M1.xsize());
+		_strassen_into(M1, M2, res, mod_arithmetic<T>{ mod }, _strassen_crossover<T>(options));
+		return res;
 	}
 }
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+#include "matrix_io.h"
+
+/*
+out-of-core (external memory) matrix multiplication for matrices stored in binary files of matrix_io.h.
+Matrices are processed in square tiles held in matrix<T>, only a bounded pool of tiles is in memory at once.
+A background thread reads the next tiles of A and B and writes finished tiles of C while the calling thread
+multiplies, so disk I/O overlaps with computation
+*/
+namespace momo
+{
+	/*
+	binary matrix file accessed by rectangular tiles. Tile rows are read / written with one seek per row
+	*/
+	template<typename T>
+	class matrix_tile_file
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "binary matrix format requires trivially copyable elements");
+
+		std::fstream _file;
+		matrix_file_header _header;
+
+		std::streamoff _offset(size_t row, size_t col) const
+		{
+			return (std::streamoff)(matrix_file_header::size + (row * (size_t)_header.cols + col) * sizeof(T));
+		}
+	public:
+		/*
+		opens existing matrix file, read-only unless [writable] is set. Returns false if it does not contain
+		matrix of T or is shorter than its header says
+		*/
+		bool open(const std::string& path, bool writable = false)
+		{
+			_file.close();
+			_file.clear();
+			_file.open(path, writable ? std::ios::binary | std::ios::in | std::ios::out : std::ios::binary | std::ios::in);
+			if (!_file || !_header.read(_file) || !_header.matches<T>() || !_header.data_fits(matrix_stream_remaining(_file)))
+			{
+				_file.close();
+				_header = matrix_file_header();
+				return false;
+			}
+			return true;
+		}
+
+		// creates [rows x cols] matrix file, contents are zero-filled by the file system
+		bool create(const std::string& path, size_t rows, size_t cols)
+		{
+			_file.close();
+			_file.clear();
+			_file.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+			_header = matrix_file_header::make<T>(rows, cols);
+			if (!_file || !_header.write(_file)) return false;
+			if (rows * cols > 0)
+			{
+				// extend file to its full size by writing the last byte
+				_file.seekp(_offset(rows, 0) - 1);
+				_file.put(0);
+			}
+			return (bool)_file.flush();
+		}
+
+		bool is_open() const
+		{
+			return _file.is_open();
+		}
+
+		size_t xsize() const
+		{
+			return (size_t)_header.rows;
+		}
+
+		size_t ysize() const
+		{
+			return (size_t)_header.cols;
+		}
+
+		// reads [tile.xsize() x tile.ysize()] block starting at (row, col)
+		bool read_tile(size_t row, size_t col, matrix<T>& tile)
+		{
+			for (size_t i = 0; i < tile.xsize(); i++)
+			{
+				_file.seekg(_offset(row + i, col));
+				if (!_file.read(reinterpret_cast<char*>(tile.vec[i].data()), (std::streamsize)(tile.ysize() * sizeof(T)))) return false;
+			}
+			return true;
+		}
+
+		bool write_tile(size_t row, size_t col, const matrix<T>& tile)
+		{
+			for (size_t i = 0; i < tile.xsize(); i++)
+			{
+				_file.seekp(_offset(row + i, col));
+				if (!_file.write(reinterpret_cast<const char*>(tile.vec[i].data()), (std::streamsize)(tile.ysize() * sizeof(T)))) return false;
+			}
+			return (bool)_file.flush();
+		}
+	};
+
+	/*
+	state shared between compute thread and I/O thread of external_mult. All fields are guarded by [mutex].
+	input tiles and accumulators are two separate bounded pools, so prefetching can never take the buffer
+	which the compute thread needs to finish current tile of C
+	*/
+	template<typename T>
+	struct _external_mult_pipeline
+	{
+		struct pending_write
+		{
+			size_t row, col;
+			matrix<T> tile;
+		};
+
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::vector<matrix<T> > free_inputs;
+		std::vector<matrix<T> > free_accumulators;
+		std::deque<std::pair<matrix<T>, matrix<T> > > ready;
+		std::deque<pending_write> writes;
+		bool compute_done = false;
+		bool failed = false;
+
+		static void fit(matrix<T>& M, size_t rows, size_t cols)
+		{
+			if (M.xsize() != rows || M.ysize() != cols) M = matrix<T>(rows, cols);
+		}
+	};
+
+	/*
+	computes C = A * B where A, B and C are binary matrix files of T. [tile] is the side of square tiles,
+	[buffer_tiles] is the total amount of tiles kept in memory (at least 6: two accumulators and two prefetched pairs).
+	Returns false if input files can not be read, sizes do not match or any I/O operation failed
+	*/
+	template<typename T>
+	bool external_mult(const std::string& a_path, const std::string& b_path, const std::string& c_path, size_t tile = 512, size_t buffer_tiles = 8)
+	{
+		matrix_tile_file<T> A, B, C;
+		if (!A.open(a_path) || !B.open(b_path) || A.ysize() != B.xsize()) return false;
+		if (!C.create(c_path, A.xsize(), B.ysize())) return false;
+		tile = std::max<size_t>(tile, 1);
+		buffer_tiles = std::max<size_t>(buffer_tiles, 6);
+
+		const size_t n = A.xsize(), k = A.ysize(), m = B.ysize();
+		const size_t tiles_n = (n + tile - 1) / tile, tiles_k = (k + tile - 1) / tile, tiles_m = (m + tile - 1) / tile;
+		if (tiles_n == 0 || tiles_m == 0) return true;
+		if (tiles_k == 0)
+		{
+			// inner dimension is zero, C is already zero-filled
+			return true;
+		}
+
+		_external_mult_pipeline<T> pipe;
+		pipe.free_accumulators.resize(2);
+		pipe.free_inputs.resize(buffer_tiles - 2);
+
+		// I/O thread: writes finished tiles as soon as they appear, otherwise prefetches next pair of input tiles
+		std::thread io([&]()
+		{
+			const size_t total_reads = tiles_n * tiles_m * tiles_k;
+			size_t next_read = 0;
+			std::unique_lock<std::mutex> lock(pipe.mutex);
+			while (!pipe.failed)
+			{
+				pipe.cv.wait(lock, [&]()
+				{
+					return pipe.failed || !pipe.writes.empty() || pipe.compute_done ||
+						(next_read < total_reads && pipe.free_inputs.size() >= 2);
+				});
+				if (pipe.failed) break;
+				if (!pipe.writes.empty())
+				{
+					auto w = std::move(pipe.writes.front());
+					pipe.writes.pop_front();
+					lock.unlock();
+					bool ok = C.write_tile(w.row, w.col, w.tile);
+					lock.lock();
+					pipe.free_accumulators.push_back(std::move(w.tile));
+					if (!ok) pipe.failed = true;
+					pipe.cv.notify_all();
+					continue;
+				}
+				if (next_read < total_reads && pipe.free_inputs.size() >= 2)
+				{
+					matrix<T> a = std::move(pipe.free_inputs.back());
+					pipe.free_inputs.pop_back();
+					matrix<T> b = std::move(pipe.free_inputs.back());
+					pipe.free_inputs.pop_back();
+					lock.unlock();
+
+					// reads follow compute order: for every tile of C all tiles along inner dimension
+					const size_t bk = next_read % tiles_k, bj = next_read / tiles_k % tiles_m, bi = next_read / tiles_k / tiles_m;
+					const size_t rows = std::min(tile, n - bi * tile), inner = std::min(tile, k - bk * tile), cols = std::min(tile, m - bj * tile);
+					_external_mult_pipeline<T>::fit(a, rows, inner);
+					_external_mult_pipeline<T>::fit(b, inner, cols);
+					bool ok = A.read_tile(bi * tile, bk * tile, a) && B.read_tile(bk * tile, bj * tile, b);
+
+					lock.lock();
+					next_read++;
+					pipe.ready.emplace_back(std::move(a), std::move(b));
+					if (!ok) pipe.failed = true;
+					pipe.cv.notify_all();
+					continue;
+				}
+				if (pipe.compute_done) break;
+			}
+		});
+
+		for (size_t bi = 0; bi < tiles_n; bi++)
+		{
+			for (size_t bj = 0; bj < tiles_m; bj++)
+			{
+				std::unique_lock<std::mutex> lock(pipe.mutex);
+				pipe.cv.wait(lock, [&]() { return pipe.failed || !pipe.free_accumulators.empty(); });
+				if (pipe.failed) break;
+				matrix<T> acc = std::move(pipe.free_accumulators.back());
+				pipe.free_accumulators.pop_back();
+				lock.unlock();
+
+				_external_mult_pipeline<T>::fit(acc, std::min(tile, n - bi * tile), std::min(tile, m - bj * tile));
+				for (auto& row : acc.vec)
+				{
+					std::fill(row.begin(), row.end(), T());
+				}
+				for (size_t bk = 0; bk < tiles_k; bk++)
+				{
+					lock.lock();
+					pipe.cv.wait(lock, [&]() { return pipe.failed || !pipe.ready.empty(); });
+					if (pipe.failed) break;
+					auto inputs = std::move(pipe.ready.front());
+					pipe.ready.pop_front();
+					lock.unlock();
+
+					mult_add_into(inputs.first, inputs.second, acc);
+
+					lock.lock();
+					pipe.free_inputs.push_back(std::move(inputs.first));
+					pipe.free_inputs.push_back(std::move(inputs.second));
+					pipe.cv.notify_all();
+					lock.unlock();
+				}
+				if (!lock.owns_lock()) lock.lock();
+				if (pipe.failed) break;
+				pipe.writes.push_back({ bi * tile, bj * tile, std::move(acc) });
+				pipe.cv.notify_all();
+			}
+		}
+
+		// wait until all tiles of C are written
+		{
+			std::unique_lock<std::mutex> lock(pipe.mutex);
+			pipe.cv.wait(lock, [&]() { return pipe.failed || (pipe.writes.empty() && pipe.free_accumulators.size() == 2); });
+			pipe.compute_done = true;
+			pipe.cv.notify_all();
+		}
+		io.join();
+		return !pipe.failed;
+	}
+}
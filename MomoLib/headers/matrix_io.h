@@ -0,0 +1,555 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+#include <type_traits>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "matrix.h"
+#include "matrix_view.h"
+
+/*
+binary matrix files. Layout is 32-byte header followed by raw row-major elements in native byte order:
+magic "MMAT", version, element type code, element size, rows and columns (64-bit each).
+Elements start at 32-byte boundary, so mapped file can be used as matrix_view directly.
+read/write_binary load and store whole matrix<T>, mapped_matrix maps file read-only without copying,
+matrix_row_reader / matrix_row_writer stream one row at a time for matrices which do not fit in memory
+*/
+namespace momo
+{
+	// element types known to the format, [custom] is any other trivially copyable type checked only by size
+	enum class matrix_element_type : uint32_t
+	{
+		custom,
+		int8,
+		uint8,
+		int16,
+		uint16,
+		int32,
+		uint32,
+		int64,
+		uint64,
+		float32,
+		float64,
+	};
+
+	template<typename T>
+	constexpr matrix_element_type matrix_element_type_of()
+	{
+		if (std::is_floating_point<T>::value)
+		{
+			return sizeof(T) == 4 ? matrix_element_type::float32 : sizeof(T) == 8 ? matrix_element_type::float64 : matrix_element_type::custom;
+		}
+		if (std::is_integral<T>::value && !std::is_same<T, bool>::value)
+		{
+			switch (sizeof(T))
+			{
+			case 1: return std::is_signed<T>::value ? matrix_element_type::int8 : matrix_element_type::uint8;
+			case 2: return std::is_signed<T>::value ? matrix_element_type::int16 : matrix_element_type::uint16;
+			case 4: return std::is_signed<T>::value ? matrix_element_type::int32 : matrix_element_type::uint32;
+			case 8: return std::is_signed<T>::value ? matrix_element_type::int64 : matrix_element_type::uint64;
+			}
+		}
+		return matrix_element_type::custom;
+	}
+
+	struct matrix_file_header
+	{
+		static constexpr uint32_t magic_value = 0x54414D4D; // "MMAT" read as little-endian uint32
+		static constexpr uint32_t current_version = 1;
+		static constexpr size_t size = 32;
+
+		uint32_t magic = magic_value;
+		uint32_t version = current_version;
+		matrix_element_type type = matrix_element_type::custom;
+		uint32_t element_size = 0;
+		uint64_t rows = 0;
+		uint64_t cols = 0;
+
+		template<typename T>
+		static matrix_file_header make(size_t rows, size_t cols)
+		{
+			matrix_file_header header;
+			header.type = matrix_element_type_of<T>();
+			header.element_size = (uint32_t)sizeof(T);
+			header.rows = rows;
+			header.cols = cols;
+			return header;
+		}
+
+		// true if file stores elements of type T (magic, version, type and size are checked)
+		template<typename T>
+		bool matches() const
+		{
+			return magic == magic_value && version == current_version &&
+				type == matrix_element_type_of<T>() && element_size == sizeof(T);
+		}
+
+		/*
+		true if rows * cols * element_size does not overflow, fits in size_t and is not greater than [max_size].
+		Sizes come from the file, so it has to be checked before data is mapped or allocated
+		*/
+		bool data_fits(uint64_t max_size) const
+		{
+			uint64_t limit = std::min<uint64_t>(max_size, std::numeric_limits<size_t>::max());
+			if (rows > std::numeric_limits<size_t>::max() || cols > std::numeric_limits<size_t>::max()) return false;
+			if (element_size == 0 || rows == 0 || cols == 0) return true;
+			uint64_t max_elements = limit / element_size;
+			return rows <= max_elements / cols;
+		}
+
+		// size of elements in bytes, saturates at UINT64_MAX if header sizes overflow (see data_fits)
+		uint64_t data_size() const
+		{
+			if (!data_fits(std::numeric_limits<uint64_t>::max())) return std::numeric_limits<uint64_t>::max();
+			return rows * cols * element_size;
+		}
+
+		void to_bytes(char* bytes) const
+		{
+			uint32_t type_code = (uint32_t)type;
+			std::memcpy(bytes, &magic, 4);
+			std::memcpy(bytes + 4, &version, 4);
+			std::memcpy(bytes + 8, &type_code, 4);
+			std::memcpy(bytes + 12, &element_size, 4);
+			std::memcpy(bytes + 16, &rows, 8);
+			std::memcpy(bytes + 24, &cols, 8);
+		}
+
+		void from_bytes(const char* bytes)
+		{
+			uint32_t type_code;
+			std::memcpy(&magic, bytes, 4);
+			std::memcpy(&version, bytes + 4, 4);
+			std::memcpy(&type_code, bytes + 8, 4);
+			std::memcpy(&element_size, bytes + 12, 4);
+			std::memcpy(&rows, bytes + 16, 8);
+			std::memcpy(&cols, bytes + 24, 8);
+			type = (matrix_element_type)type_code;
+		}
+
+		bool write(std::ostream& os) const
+		{
+			char bytes[size];
+			to_bytes(bytes);
+			return (bool)os.write(bytes, size);
+		}
+
+		bool read(std::istream& is)
+		{
+			char bytes[size];
+			if (!is.read(bytes, size)) return false;
+			from_bytes(bytes);
+			return true;
+		}
+	};
+
+	/*
+	amount of bytes from current position to the end of stream. Streams which can not seek
+	(pipes, sockets) return UINT64_MAX, their data is limited by what can be read
+	*/
+	inline uint64_t matrix_stream_remaining(std::istream& is)
+	{
+		std::istream::pos_type current = is.tellg();
+		if (current == std::istream::pos_type(-1)) return std::numeric_limits<uint64_t>::max();
+		if (!is.seekg(0, std::ios::end))
+		{
+			is.clear();
+			is.seekg(current);
+			return std::numeric_limits<uint64_t>::max();
+		}
+		std::istream::pos_type end = is.tellg();
+		is.seekg(current);
+		if (end == std::istream::pos_type(-1) || end < current) return std::numeric_limits<uint64_t>::max();
+		return (uint64_t)(end - current);
+	}
+
+	/*
+	writes M in binary format, returns false if stream failed
+	*/
+	template<typename T>
+	bool write_binary(std::ostream& os, const matrix<T>& M)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "binary matrix format requires trivially copyable elements");
+		if (!matrix_file_header::make<T>(M.xsize(), M.ysize()).write(os)) return false;
+		for (const auto& row : M.vec)
+		{
+			if (!os.write(reinterpret_cast<const char*>(row.data()), (std::streamsize)(row.size() * sizeof(T)))) return false;
+		}
+		return true;
+	}
+
+	template<typename T>
+	bool write_binary(const std::string& path, const matrix<T>& M)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		return file && write_binary(file, M) && file.flush();
+	}
+
+	/*
+	reads matrix written by write_binary into res. Returns false and leaves res unchanged
+	if header is invalid, element type differs from T or data is truncated. Sizes of header are checked
+	against the rest of stream before matrix is allocated
+	*/
+	template<typename T>
+	bool read_binary(std::istream& is, matrix<T>& res)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "binary matrix format requires trivially copyable elements");
+		matrix_file_header header;
+		if (!header.read(is) || !header.matches<T>() || !header.data_fits(matrix_stream_remaining(is))) return false;
+		matrix<T> M((size_t)header.rows, (size_t)header.cols);
+		for (auto& row : M.vec)
+		{
+			if (!is.read(reinterpret_cast<char*>(row.data()), (std::streamsize)(row.size() * sizeof(T)))) return false;
+		}
+		res.swap(M);
+		return true;
+	}
+
+	template<typename T>
+	bool read_binary(const std::string& path, matrix<T>& res)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return file && read_binary(file, res);
+	}
+
+	/*
+	read-only memory mapping of binary matrix file. Pages are loaded by OS on first access, so opening is O(1)
+	and matrix bigger than RAM can be viewed as long as it fits in address space. view() is valid while mapping is alive
+	*/
+	template<typename T>
+	class mapped_matrix
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "binary matrix format requires trivially copyable elements");
+
+		const char* _base = nullptr;
+		size_t _length = 0;
+		matrix_file_header _header;
+		#ifdef _WIN32
+		HANDLE _file = INVALID_HANDLE_VALUE;
+		HANDLE _mapping = nullptr;
+		#endif
+
+		void _reset()
+		{
+			_base = nullptr;
+			_length = 0;
+			_header = matrix_file_header();
+			#ifdef _WIN32
+			_file = INVALID_HANDLE_VALUE;
+			_mapping = nullptr;
+			#endif
+		}
+
+		void _steal(mapped_matrix& other)
+		{
+			_base = other._base;
+			_length = other._length;
+			_header = other._header;
+			#ifdef _WIN32
+			_file = other._file;
+			_mapping = other._mapping;
+			#endif
+			other._reset();
+		}
+	public:
+		mapped_matrix() = default;
+
+		explicit mapped_matrix(const std::string& path)
+		{
+			open(path);
+		}
+
+		mapped_matrix(const mapped_matrix&) = delete;
+		mapped_matrix& operator=(const mapped_matrix&) = delete;
+
+		mapped_matrix(mapped_matrix&& other) noexcept
+		{
+			_steal(other);
+		}
+
+		mapped_matrix& operator=(mapped_matrix&& other) noexcept
+		{
+			if (this != &other)
+			{
+				close();
+				_steal(other);
+			}
+			return *this;
+		}
+
+		~mapped_matrix()
+		{
+			close();
+		}
+
+		/*
+		maps file, returns false if it can not be mapped or does not contain matrix of T
+		*/
+		bool open(const std::string& path)
+		{
+			close();
+			#ifdef _WIN32
+			_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (_file == INVALID_HANDLE_VALUE) return false;
+			LARGE_INTEGER file_size;
+			if (!GetFileSizeEx(_file, &file_size) || file_size.QuadPart < (LONGLONG)matrix_file_header::size)
+			{
+				close();
+				return false;
+			}
+			_length = (size_t)file_size.QuadPart;
+			_mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (_mapping == nullptr)
+			{
+				close();
+				return false;
+			}
+			_base = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+			if (_base == nullptr)
+			{
+				close();
+				return false;
+			}
+			#else
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) return false;
+			struct stat st;
+			if (fstat(fd, &st) != 0 || st.st_size < (off_t)matrix_file_header::size)
+			{
+				::close(fd);
+				return false;
+			}
+			_length = (size_t)st.st_size;
+			void* base = mmap(nullptr, _length, PROT_READ, MAP_SHARED, fd, 0);
+			::close(fd); // mapping keeps its own reference to the file
+			if (base == MAP_FAILED)
+			{
+				_length = 0;
+				return false;
+			}
+			_base = static_cast<const char*>(base);
+			#endif
+			_header.from_bytes(_base);
+			if (!_header.matches<T>() || !_header.data_fits(_length - matrix_file_header::size))
+			{
+				close();
+				return false;
+			}
+			return true;
+		}
+
+		void close()
+		{
+			#ifdef _WIN32
+			if (_base != nullptr) UnmapViewOfFile(_base);
+			if (_mapping != nullptr) CloseHandle(_mapping);
+			if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+			#else
+			if (_base != nullptr) munmap(const_cast<char*>(_base), _length);
+			#endif
+			_reset();
+		}
+
+		bool is_open() const
+		{
+			return _base != nullptr;
+		}
+
+		size_t xsize() const
+		{
+			return (size_t)_header.rows;
+		}
+
+		size_t ysize() const
+		{
+			return (size_t)_header.cols;
+		}
+
+		const T* data() const
+		{
+			return _base == nullptr ? nullptr : reinterpret_cast<const T*>(_base + matrix_file_header::size);
+		}
+
+		matrix_view<const T> view() const
+		{
+			return matrix_view<const T>(data(), xsize(), ysize());
+		}
+
+		// copies mapped data into owning matrix
+		matrix<T> to_matrix() const
+		{
+			return view().to_matrix();
+		}
+	};
+
+	/*
+	writes matrix row by row, so only one row has to be in memory. Row count is patched into header
+	on close(), so it does not have to be known in advance
+	*/
+	template<typename T>
+	class matrix_row_writer
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "binary matrix format requires trivially copyable elements");
+
+		std::ofstream _file;
+		matrix_file_header _header;
+	public:
+		matrix_row_writer() = default;
+
+		matrix_row_writer(const std::string& path, size_t cols)
+		{
+			open(path, cols);
+		}
+
+		~matrix_row_writer()
+		{
+			close();
+		}
+
+		bool open(const std::string& path, size_t cols)
+		{
+			close();
+			_header = matrix_file_header::make<T>(0, cols);
+			_file.open(path, std::ios::binary | std::ios::trunc);
+			return _file && _header.write(_file);
+		}
+
+		bool is_open() const
+		{
+			return _file.is_open();
+		}
+
+		size_t rows() const
+		{
+			return (size_t)_header.rows;
+		}
+
+		size_t cols() const
+		{
+			return (size_t)_header.cols;
+		}
+
+		// writes cols() elements starting at [row]
+		bool write_row(const T* row)
+		{
+			if (!_file.write(reinterpret_cast<const char*>(row), (std::streamsize)(cols() * sizeof(T)))) return false;
+			_header.rows++;
+			return true;
+		}
+
+		// returns false if row size differs from cols()
+		bool write_row(const std::vector<T>& row)
+		{
+			return row.size() == cols() && write_row(row.data());
+		}
+
+		// finalizes header, returns false if any write failed
+		bool close()
+		{
+			if (!_file.is_open()) return true;
+			_file.seekp(0);
+			bool ok = _header.write(_file) && _file.flush();
+			_file.close();
+			return ok;
+		}
+	};
+
+	/*
+	reads binary matrix row by row without loading it in memory
+	*/
+	template<typename T>
+	class matrix_row_reader
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "binary matrix format requires trivially copyable elements");
+
+		std::ifstream _file;
+		matrix_file_header _header;
+		size_t _next_row = 0;
+	public:
+		matrix_row_reader() = default;
+
+		explicit matrix_row_reader(const std::string& path)
+		{
+			open(path);
+		}
+
+		// returns false if file can not be opened or does not contain matrix of T
+		bool open(const std::string& path)
+		{
+			_file.close();
+			_file.clear();
+			_next_row = 0;
+			_file.open(path, std::ios::binary);
+			if (!_file || !_header.read(_file) || !_header.matches<T>() || !_header.data_fits(matrix_stream_remaining(_file)))
+			{
+				_file.close();
+				_header = matrix_file_header();
+				return false;
+			}
+			return true;
+		}
+
+		bool is_open() const
+		{
+			return _file.is_open();
+		}
+
+		size_t rows() const
+		{
+			return (size_t)_header.rows;
+		}
+
+		size_t cols() const
+		{
+			return (size_t)_header.cols;
+		}
+
+		// index of row which will be returned by next read_row()
+		size_t position() const
+		{
+			return _next_row;
+		}
+
+		// moves to row [i], returns false if there is no such row
+		bool seek(size_t i)
+		{
+			if (!is_open() || i > rows()) return false;
+			_file.clear();
+			_file.seekg((std::streamoff)(matrix_file_header::size + i * cols() * sizeof(T)));
+			_next_row = i;
+			return (bool)_file;
+		}
+
+		// reads cols() elements into [row], returns false after the last row
+		bool read_row(T* row)
+		{
+			if (!is_open() || _next_row >= rows()) return false;
+			if (!_file.read(reinterpret_cast<char*>(row), (std::streamsize)(cols() * sizeof(T)))) return false;
+			_next_row++;
+			return true;
+		}
+
+		bool read_row(std::vector<T>& row)
+		{
+			row.resize(cols());
+			return read_row(row.data());
+		}
+	};
+}
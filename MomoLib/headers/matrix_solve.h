@@ -0,0 +1,470 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+
+#include "matrix.h"
+#include "matrix_view.h"
+
+/*
+linear systems for matrix<T>: blocked LU with partial pivoting, blocked Cholesky, triangular solves, determinant and inverse.
+Overloads with mod parameter do the same Gaussian elimination over integers modulo prime number (elements must be in [0; mod)).
+Overloads without mod need a field (floating point, complex, rational): integer division would truncate, so they do not compile for integer T.
+Factorizations work panel by panel: the trailing submatrix is updated by one matrix product per panel, so most of the work is done by GEMM kernel.
+Nothing throws: check singular() / positive_definite() of decomposition, helpers return empty result on failure
+*/
+namespace momo
+{
+	// pivot selection: largest absolute value for real numbers, any non-zero value for modular field
+	template<typename T>
+	auto _pivot_score(const T& value, const plain_arithmetic<T>&)
+	{
+		using std::abs;
+		return abs(value);
+	}
+
+	template<typename T>
+	int _pivot_score(const T& value, const mod_arithmetic<T>&)
+	{
+		return value == T() ? 0 : 1;
+	}
+
+	// res -= M1 * M2, product is computed by blocked kernel of arithmetic policy
+	template<typename T, typename V1, typename V2, typename Arithmetic>
+	void _subtract_product(const V1& M1, const V2& M2, matrix_rows_view<T> res, const Arithmetic& ar)
+	{
+		matrix<T> A = M1.to_matrix(), B = M2.to_matrix(), C(A.xsize(), B.ysize());
+		ar.mult_into(A, B, C);
+		for (size_t i = 0; i < C.xsize(); i++)
+		{
+			for (size_t j = 0; j < C.ysize(); j++)
+			{
+				res(i, j) = ar.sub(res(i, j), C.vec[i][j]);
+			}
+		}
+	}
+
+	/*
+	forward substitution: solves L * x = b for lower triangular L. Upper triangle of L is ignored
+	*/
+	template<typename T>
+	std::vector<T> solve_lower(const matrix<T>& L, std::vector<T> b, bool unit_diagonal = false)
+	{
+		for (size_t i = 0; i < b.size(); i++)
+		{
+			const std::vector<T>& row = L.vec[i];
+			for (size_t k = 0; k < i; k++)
+			{
+				b[i] -= row[k] * b[k];
+			}
+			if (!unit_diagonal) b[i] /= row[i];
+		}
+		return b;
+	}
+
+	/*
+	back substitution: solves U * x = b for upper triangular U. If [transposed] is set, U is taken as transpose of lower triangle of given matrix
+	*/
+	template<typename T>
+	std::vector<T> solve_upper(const matrix<T>& U, std::vector<T> b, bool transposed = false)
+	{
+		for (size_t i = b.size(); i-- > 0; )
+		{
+			for (size_t k = i + 1; k < b.size(); k++)
+			{
+				b[i] -= (transposed ? U.vec[k][i] : U.vec[i][k]) * b[k];
+			}
+			b[i] /= U.vec[i][i];
+		}
+		return b;
+	}
+
+	/*
+	PA = LU. L (unit diagonal, not stored) and U are packed in one matrix, perm[i] is row of A which became row i
+	*/
+	template<typename T, typename Arithmetic = plain_arithmetic<T> >
+	class lu_decomposition
+	{
+		matrix<T> _lu;
+		std::vector<size_t> _perm;
+		bool _odd_permutation = false;
+		bool _singular = false;
+		Arithmetic _ar;
+
+		static_assert(!std::is_integral<T>::value || !std::is_same<Arithmetic, plain_arithmetic<T> >::value,
+			"integer division truncates, factorize integer matrices modulo prime: lu(A, mod), determinant(A, mod), solve(A, b, mod)");
+
+		void _factorize(size_t block)
+		{
+			const size_t n = _lu.xsize();
+			auto a = view(_lu);
+			for (size_t k0 = 0; k0 < n; k0 += block)
+			{
+				const size_t k1 = std::min(k0 + block, n);
+				// panel: unblocked elimination of columns [k0; k1)
+				for (size_t k = k0; k < k1; k++)
+				{
+					size_t p = k;
+					for (size_t i = k + 1; i < n; i++)
+					{
+						if (_pivot_score(_lu.vec[p][k], _ar) < _pivot_score(_lu.vec[i][k], _ar)) p = i;
+					}
+					if (_lu.vec[p][k] == T())
+					{
+						_singular = true;
+						continue;
+					}
+					if (p != k)
+					{
+						_lu.vec[p].swap(_lu.vec[k]); // rows are separate vectors, so swap is O(1)
+						std::swap(_perm[p], _perm[k]);
+						_odd_permutation = !_odd_permutation;
+					}
+					const std::vector<T>& pivot_row = _lu.vec[k];
+					for (size_t i = k + 1; i < n; i++)
+					{
+						std::vector<T>& row = _lu.vec[i];
+						row[k] = _ar.div(row[k], pivot_row[k]);
+						if (row[k] == T()) continue;
+						for (size_t j = k + 1; j < k1; j++)
+						{
+							row[j] = _ar.sub(row[j], _ar.mul(row[k], pivot_row[j]));
+						}
+					}
+				}
+				if (k1 == n) break;
+				// U12 = L11^-1 * A12
+				for (size_t k = k0; k < k1; k++)
+				{
+					for (size_t i = k + 1; i < k1; i++)
+					{
+						const T& l = _lu.vec[i][k];
+						if (l == T()) continue;
+						for (size_t j = k1; j < n; j++)
+						{
+							_lu.vec[i][j] = _ar.sub(_lu.vec[i][j], _ar.mul(l, _lu.vec[k][j]));
+						}
+					}
+				}
+				// A22 -= L21 * U12
+				_subtract_product(a.block(k1, k0, n - k1, k1 - k0), a.block(k0, k1, k1 - k0, n - k1), a.block(k1, k1, n - k1, n - k1), _ar);
+			}
+		}
+
+		// B <- U^-1 * L^-1 * P * B, rows of B are processed as whole vectors
+		void _solve_rows(std::vector<std::vector<T> >& B) const
+		{
+			const size_t n = _lu.xsize();
+			std::vector<std::vector<T> > permuted(n);
+			for (size_t i = 0; i < n; i++)
+			{
+				permuted[i] = std::move(B[_perm[i]]);
+			}
+			B.swap(permuted);
+			for (size_t i = 0; i < n; i++)
+			{
+				for (size_t k = 0; k < i; k++)
+				{
+					const T& l = _lu.vec[i][k];
+					if (l == T()) continue;
+					for (size_t j = 0; j < B[i].size(); j++)
+					{
+						B[i][j] = _ar.sub(B[i][j], _ar.mul(l, B[k][j]));
+					}
+				}
+			}
+			for (size_t i = n; i-- > 0; )
+			{
+				for (size_t k = i + 1; k < n; k++)
+				{
+					const T& u = _lu.vec[i][k];
+					if (u == T()) continue;
+					for (size_t j = 0; j < B[i].size(); j++)
+					{
+						B[i][j] = _ar.sub(B[i][j], _ar.mul(u, B[k][j]));
+					}
+				}
+				for (size_t j = 0; j < B[i].size(); j++)
+				{
+					B[i][j] = _ar.div(B[i][j], _lu.vec[i][i]);
+				}
+			}
+		}
+	public:
+		lu_decomposition(const matrix<T>& A, Arithmetic ar = Arithmetic(), size_t block = matrix_block_size)
+			: _lu(A), _perm(A.xsize()), _ar(ar)
+		{
+			for (size_t i = 0; i < _perm.size(); i++)
+			{
+				_perm[i] = i;
+			}
+			if (A.xsize() != A.ysize())
+			{
+				_singular = true;
+				return;
+			}
+			_factorize(std::max<size_t>(block, 1));
+		}
+
+		bool singular() const
+		{
+			return _singular;
+		}
+
+		// packed L and U factors
+		const matrix<T>& factors() const
+		{
+			return _lu;
+		}
+
+		const std::vector<size_t>& permutation() const
+		{
+			return _perm;
+		}
+
+		matrix<T> lower() const
+		{
+			matrix<T> res = matrix<T>::identity(_lu.xsize());
+			for (size_t i = 0; i < _lu.xsize(); i++)
+			{
+				for (size_t j = 0; j < i; j++)
+				{
+					res.vec[i][j] = _lu.vec[i][j];
+				}
+			}
+			return res;
+		}
+
+		matrix<T> upper() const
+		{
+			matrix<T> res(_lu.xsize());
+			for (size_t i = 0; i < _lu.xsize(); i++)
+			{
+				for (size_t j = i; j < _lu.ysize(); j++)
+				{
+					res.vec[i][j] = _lu.vec[i][j];
+				}
+			}
+			return res;
+		}
+
+		T determinant() const
+		{
+			if (_singular) return T();
+			T det = T(1);
+			for (size_t i = 0; i < _lu.xsize(); i++)
+			{
+				det = _ar.mul(det, _lu.vec[i][i]);
+			}
+			return _odd_permutation ? _ar.sub(T(), det) : det;
+		}
+
+		/*
+		solves A * x = b. Returns empty vector if A is singular or sizes do not match
+		*/
+		std::vector<T> solve(const std::vector<T>& b) const
+		{
+			if (_singular || b.size() != _lu.xsize()) return std::vector<T>();
+			std::vector<std::vector<T> > B(b.size());
+			for (size_t i = 0; i < b.size(); i++)
+			{
+				B[i].assign(1, b[i]);
+			}
+			_solve_rows(B);
+			std::vector<T> x(b.size());
+			for (size_t i = 0; i < x.size(); i++)
+			{
+				x[i] = B[i][0];
+			}
+			return x;
+		}
+
+		/*
+		solves A * X = B for all columns of B at once. Returns empty matrix if A is singular or sizes do not match
+		*/
+		matrix<T> solve(const matrix<T>& B) const
+		{
+			if (_singular || B.xsize() != _lu.xsize()) return matrix<T>();
+			std::vector<std::vector<T> > X = B.vec;
+			_solve_rows(X);
+			return matrix<T>(X);
+		}
+
+		matrix<T> inverse() const
+		{
+			return solve(matrix<T>::identity(_lu.xsize()));
+		}
+	};
+
+	/*
+	A = L * L^T for symmetric positive definite A. Only lower triangle of A is read
+	*/
+	template<typename T>
+	class cholesky_decomposition
+	{
+		matrix<T> _l;
+		bool _positive_definite = true;
+
+		static_assert(!std::is_integral<T>::value, "cholesky_decomposition needs square roots and division, integer T is not supported");
+
+		void _factorize(size_t block)
+		{
+			using std::sqrt;
+			const size_t n = _l.xsize();
+			auto a = view(_l);
+			for (size_t k0 = 0; k0 < n; k0 += block)
+			{
+				const size_t k1 = std::min(k0 + block, n);
+				// diagonal block and L21 = A21 * L11^-T, previous panels are already subtracted from them
+				for (size_t j = k0; j < k1; j++)
+				{
+					T d = _l.vec[j][j];
+					for (size_t k = k0; k < j; k++)
+					{
+						d -= _l.vec[j][k] * _l.vec[j][k];
+					}
+					if (!(T() < d))
+					{
+						_positive_definite = false;
+						return;
+					}
+					d = sqrt(d);
+					_l.vec[j][j] = d;
+					for (size_t i = j + 1; i < n; i++)
+					{
+						T s = _l.vec[i][j];
+						for (size_t k = k0; k < j; k++)
+						{
+							s -= _l.vec[i][k] * _l.vec[j][k];
+						}
+						_l.vec[i][j] = s / d;
+					}
+				}
+				if (k1 == n) break;
+				// A22 -= L21 * L21^T
+				auto l21 = a.block(k1, k0, n - k1, k1 - k0);
+				_subtract_product(l21, l21.transposed(), a.block(k1, k1, n - k1, n - k1), plain_arithmetic<T>());
+			}
+			for (size_t i = 0; i < n; i++)
+			{
+				std::fill(_l.vec[i].begin() + i + 1, _l.vec[i].end(), T());
+			}
+		}
+	public:
+		cholesky_decomposition(const matrix<T>& A, size_t block = matrix_block_size)
+			: _l(A)
+		{
+			if (A.xsize() != A.ysize())
+			{
+				_positive_definite = false;
+				return;
+			}
+			_factorize(std::max<size_t>(block, 1));
+		}
+
+		bool positive_definite() const
+		{
+			return _positive_definite;
+		}
+
+		const matrix<T>& lower() const
+		{
+			return _l;
+		}
+
+		T determinant() const
+		{
+			if (!_positive_definite) return T();
+			T det = T(1);
+			for (size_t i = 0; i < _l.xsize(); i++)
+			{
+				det *= _l.vec[i][i] * _l.vec[i][i];
+			}
+			return det;
+		}
+
+		std::vector<T> solve(const std::vector<T>& b) const
+		{
+			if (!_positive_definite || b.size() != _l.xsize()) return std::vector<T>();
+			return solve_upper(_l, solve_lower(_l, b), true);
+		}
+
+		matrix<T> solve(const matrix<T>& B) const
+		{
+			if (!_positive_definite || B.xsize() != _l.xsize()) return matrix<T>();
+			matrix<T> X(B.xsize(), B.ysize());
+			std::vector<T> column(B.xsize());
+			for (size_t j = 0; j < B.ysize(); j++)
+			{
+				for (size_t i = 0; i < B.xsize(); i++) column[i] = B.vec[i][j];
+				column = solve(column);
+				for (size_t i = 0; i < B.xsize(); i++) X.vec[i][j] = column[i];
+			}
+			return X;
+		}
+
+		matrix<T> inverse() const
+		{
+			return solve(matrix<T>::identity(_l.xsize()));
+		}
+	};
+
+	template<typename T>
+	lu_decomposition<T> lu(const matrix<T>& A)
+	{
+		return lu_decomposition<T>(A);
+	}
+
+	template<typename T>
+	lu_decomposition<T, mod_arithmetic<T> > lu(const matrix<T>& A, T mod)
+	{
+		return lu_decomposition<T, mod_arithmetic<T> >(A, mod_arithmetic<T>{ mod });
+	}
+
+	template<typename T>
+	cholesky_decomposition<T> cholesky(const matrix<T>& A)
+	{
+		return cholesky_decomposition<T>(A);
+	}
+
+	template<typename T>
+	T determinant(const matrix<T>& A)
+	{
+		return lu(A).determinant();
+	}
+
+	/*
+	determinant modulo prime number. Value is in [0; mod)
+	*/
+	template<typename T>
+	T determinant(const matrix<T>& A, T mod)
+	{
+		return lu(A, mod).determinant();
+	}
+
+	template<typename T>
+	matrix<T> inverse(const matrix<T>& A)
+	{
+		return lu(A).inverse();
+	}
+
+	template<typename T>
+	matrix<T> inverse(const matrix<T>& A, T mod)
+	{
+		return lu(A, mod).inverse();
+	}
+
+	template<typename T>
+	std::vector<T> solve(const matrix<T>& A, const std::vector<T>& b)
+	{
+		return lu(A).solve(b);
+	}
+
+	template<typename T>
+	std::vector<T> solve(const matrix<T>& A, const std::vector<T>& b, T mod)
+	{
+		return lu(A, mod).solve(b);
+	}
+}
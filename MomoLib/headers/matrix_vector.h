@@ -0,0 +1,450 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <initializer_list>
+#include <iostream>
+
+#include "matrix.h"
+
+/*
+dense vector and matrix-vector products (GEMV). dense_vector<T> keeps its values in one contiguous buffer,
+so M * x does not build n x 1 matrix<T> and does not go through matrix product.
+gemv kernels process four rows at once sharing every load of x, can split rows between threads,
+and batched version multiplies one matrix by many vectors streaming the matrix only once
+*/
+namespace momo
+{
+	// products with less elements than this are computed in one thread even if more threads are requested
+	constexpr size_t gemv_parallel_threshold = 1 << 16;
+
+	inline size_t gemv_default_threads()
+	{
+		size_t threads = std::thread::hardware_concurrency();
+		return threads == 0 ? 1 : threads;
+	}
+
+	/*
+	amount of threads for gemv functions. It is a separate type, so integer argument of gemv is always modulus
+	as in mult: gemv(M, x, gemv_threads(4)), gemv(M, x, mod, gemv_threads::all())
+	*/
+	struct gemv_threads
+	{
+		size_t count;
+
+		explicit gemv_threads(size_t count = 1)
+			: count(count) { }
+
+		static gemv_threads all()
+		{
+			return gemv_threads(gemv_default_threads());
+		}
+	};
+
+	template<typename T>
+	class dense_vector
+	{
+	public:
+		using value_type = T;
+		using iterator = typename std::vector<T>::iterator;
+		using const_iterator = typename std::vector<T>::const_iterator;
+
+		std::vector<T> data;
+
+		dense_vector() = default;
+
+		explicit dense_vector(size_t size, const T& value = T())
+			: data(size, value) { }
+
+		dense_vector(std::initializer_list<T> values)
+			: data(values) { }
+
+		explicit dense_vector(std::vector<T> values)
+			: data(std::move(values)) { }
+
+		// column [j] of M
+		static dense_vector column(const matrix<T>& M, size_t j = 0)
+		{
+			dense_vector res(M.xsize());
+			for (size_t i = 0; i < M.xsize(); i++)
+			{
+				res.data[i] = M.vec[i][j];
+			}
+			return res;
+		}
+
+		size_t size() const
+		{
+			return data.size();
+		}
+
+		bool empty() const
+		{
+			return data.empty();
+		}
+
+		void resize(size_t size, const T& value = T())
+		{
+			data.resize(size, value);
+		}
+
+		T& operator[](size_t i)
+		{
+			return data[i];
+		}
+
+		const T& operator[](size_t i) const
+		{
+			return data[i];
+		}
+
+		iterator begin()
+		{
+			return data.begin();
+		}
+
+		iterator end()
+		{
+			return data.end();
+		}
+
+		const_iterator begin() const
+		{
+			return data.begin();
+		}
+
+		const_iterator end() const
+		{
+			return data.end();
+		}
+
+		const std::vector<T>& to_vector() const
+		{
+			return data;
+		}
+
+		// n x 1 matrix
+		matrix<T> to_matrix() const
+		{
+			matrix<T> res(data.size(), 1);
+			for (size_t i = 0; i < data.size(); i++)
+			{
+				res.vec[i][0] = data[i];
+			}
+			return res;
+		}
+
+		bool operator==(const dense_vector& v) const
+		{
+			return data == v.data;
+		}
+
+		bool operator!=(const dense_vector& v) const
+		{
+			return !(*this == v);
+		}
+
+		// as matrix<T> does, leaves vector unchanged if sizes do not match
+		dense_vector& operator+=(const dense_vector& v)
+		{
+			if (size() != v.size()) return *this;
+			for (size_t i = 0; i < data.size(); i++)
+			{
+				data[i] += v.data[i];
+			}
+			return *this;
+		}
+
+		dense_vector& operator-=(const dense_vector& v)
+		{
+			if (size() != v.size()) return *this;
+			for (size_t i = 0; i < data.size(); i++)
+			{
+				data[i] -= v.data[i];
+			}
+			return *this;
+		}
+
+		dense_vector& operator*=(const T& value)
+		{
+			for (T& x : data)
+			{
+				x *= value;
+			}
+			return *this;
+		}
+
+		dense_vector& operator/=(const T& value)
+		{
+			for (T& x : data)
+			{
+				x /= value; // no check for devision-by-zero
+			}
+			return *this;
+		}
+
+		dense_vector operator+(const dense_vector& v) const
+		{
+			dense_vector res = *this;
+			return res += v;
+		}
+
+		dense_vector operator-(const dense_vector& v) const
+		{
+			dense_vector res = *this;
+			return res -= v;
+		}
+
+		dense_vector operator*(const T& value) const
+		{
+			dense_vector res = *this;
+			return res *= value;
+		}
+
+		dense_vector operator/(const T& value) const
+		{
+			dense_vector res = *this;
+			return res /= value;
+		}
+	};
+
+	/*
+	returns sum of v1[i] * v2[i], T() if sizes do not match
+	*/
+	template<typename T>
+	T dot(const dense_vector<T>& v1, const dense_vector<T>& v2)
+	{
+		if (v1.size() != v2.size()) return T();
+		T s0 = T(), s1 = T();
+		size_t i = 0;
+		for (; i + 1 < v1.size(); i += 2)
+		{
+			s0 += v1[i] * v2[i];
+			s1 += v1[i + 1] * v2[i + 1];
+		}
+		if (i < v1.size()) s0 += v1[i] * v2[i];
+		return s0 + s1;
+	}
+
+	/*
+	y += alpha * x, y is unchanged if sizes do not match
+	*/
+	template<typename T>
+	void axpy(const T& alpha, const dense_vector<T>& x, dense_vector<T>& y)
+	{
+		if (x.size() != y.size()) return;
+		for (size_t i = 0; i < x.size(); i++)
+		{
+			y[i] += alpha * x[i];
+		}
+	}
+
+	/*
+	splits [0; n) into [threads] chunks of whole row groups and calls func(begin, end) for each of them,
+	the calling thread processes the first chunk itself. [work] is total amount of elements touched
+	*/
+	template<typename Func>
+	void _gemv_parallel_rows(size_t n, size_t work, size_t threads, Func&& func)
+	{
+		const size_t groups = (n + 3) / 4;
+		if (threads <= 1 || groups < 2 || work < gemv_parallel_threshold)
+		{
+			func(size_t(0), n);
+			return;
+		}
+		threads = std::min(threads, groups);
+		std::vector<std::thread> workers;
+		workers.reserve(threads - 1);
+		for (size_t t = 1; t < threads; t++)
+		{
+			size_t begin = std::min(n, groups * t / threads * 4);
+			size_t end = std::min(n, groups * (t + 1) / threads * 4);
+			workers.emplace_back([&func, begin, end]() { func(begin, end); });
+		}
+		func(size_t(0), std::min(n, groups / threads * 4));
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	/*
+	res[i] = row(i) * x for rows [begin; end). Four rows are processed together with independent accumulators:
+	every x[j] is loaded once for four rows and additions of different rows do not wait for each other
+	*/
+	template<typename T, typename Arithmetic>
+	void _gemv_rows(const matrix<T>& M, const T* x, T* res, size_t begin, size_t end, const Arithmetic& ar)
+	{
+		const size_t m = M.ysize();
+		size_t i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			const T* r0 = M.vec[i].data();
+			const T* r1 = M.vec[i + 1].data();
+			const T* r2 = M.vec[i + 2].data();
+			const T* r3 = M.vec[i + 3].data();
+			T s0 = T(), s1 = T(), s2 = T(), s3 = T();
+			for (size_t j = 0; j < m; j++)
+			{
+				const T& xj = x[j];
+				s0 = ar.add(s0, ar.mul(r0[j], xj));
+				s1 = ar.add(s1, ar.mul(r1[j], xj));
+				s2 = ar.add(s2, ar.mul(r2[j], xj));
+				s3 = ar.add(s3, ar.mul(r3[j], xj));
+			}
+			res[i] = s0;
+			res[i + 1] = s1;
+			res[i + 2] = s2;
+			res[i + 3] = s3;
+		}
+		for (; i < end; i++)
+		{
+			const T* row = M.vec[i].data();
+			T sum = T();
+			for (size_t j = 0; j < m; j++)
+			{
+				sum = ar.add(sum, ar.mul(row[j], x[j]));
+			}
+			res[i] = sum;
+		}
+	}
+
+	template<typename T, typename Arithmetic>
+	void _gemv_into(const matrix<T>& M, const dense_vector<T>& x, dense_vector<T>& res, const Arithmetic& ar, size_t threads)
+	{
+		_gemv_parallel_rows(M.xsize(), M.xsize() * M.ysize(), threads, [&](size_t begin, size_t end)
+		{
+			_gemv_rows(M, x.data.data(), res.data.data(), begin, end, ar);
+		});
+	}
+
+	/*
+	computes M * x into preallocated res (res.size() == M.xsize(), res must not alias x).
+	rows are shared between [threads] threads, small matrices are always processed sequentially
+	*/
+	template<typename T>
+	void gemv_into(const matrix<T>& M, const dense_vector<T>& x, dense_vector<T>& res, gemv_threads threads = gemv_threads())
+	{
+		_gemv_into(M, x, res, plain_arithmetic<T>(), threads.count);
+	}
+
+	template<typename T>
+	void gemv_into(const matrix<T>& M, const dense_vector<T>& x, dense_vector<T>& res, T mod, gemv_threads threads = gemv_threads())
+	{
+		_gemv_into(M, x, res, mod_arithmetic<T>{ mod }, threads.count);
+	}
+
+	/*
+	returns M * x, empty vector if sizes do not match
+	*/
+	template<typename T>
+	dense_vector<T> gemv(const matrix<T>& M, const dense_vector<T>& x, gemv_threads threads = gemv_threads::all())
+	{
+		if (M.ysize() != x.size()) return dense_vector<T>();
+		dense_vector<T> res(M.xsize());
+		gemv_into(M, x, res, threads);
+		return res;
+	}
+
+	template<typename T>
+	dense_vector<T> gemv(const matrix<T>& M, const dense_vector<T>& x, T mod, gemv_threads threads = gemv_threads::all())
+	{
+		if (M.ysize() != x.size()) return dense_vector<T>();
+		dense_vector<T> res(M.xsize());
+		gemv_into(M, x, res, mod, threads);
+		return res;
+	}
+
+	// single-threaded, use gemv with gemv_threads to share rows between threads
+	template<typename T>
+	dense_vector<T> operator*(const matrix<T>& M, const dense_vector<T>& x)
+	{
+		return gemv(M, x, gemv_threads());
+	}
+
+	template<typename T>
+	dense_vector<T> operator*(const T& value, const dense_vector<T>& v)
+	{
+		dense_vector<T> res(v.size());
+		for (size_t i = 0; i < v.size(); i++)
+		{
+			res[i] = value * v[i];
+		}
+		return res;
+	}
+
+	/*
+	batched GEMV: res[b] = M * xs[b] for every vector of the batch. Each group of four rows is multiplied by all
+	vectors before moving to the next group, so the matrix is read from memory once per batch instead of once per vector.
+	res is resized to xs.size() vectors of M.xsize() elements, vectors with wrong size give empty results
+	*/
+	template<typename T, typename Arithmetic>
+	void _gemv_batch_into(const matrix<T>& M, const std::vector<dense_vector<T> >& xs, std::vector<dense_vector<T> >& res, const Arithmetic& ar, size_t threads)
+	{
+		res.resize(xs.size());
+		std::vector<size_t> batch;
+		batch.reserve(xs.size());
+		for (size_t b = 0; b < xs.size(); b++)
+		{
+			if (xs[b].size() == M.ysize())
+			{
+				res[b].resize(M.xsize());
+				batch.push_back(b);
+			}
+			else
+			{
+				res[b] = dense_vector<T>();
+			}
+		}
+		_gemv_parallel_rows(M.xsize(), M.xsize() * M.ysize() * batch.size(), threads, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i += 4)
+			{
+				size_t last = std::min(end, i + 4);
+				for (size_t b : batch)
+				{
+					_gemv_rows(M, xs[b].data.data(), res[b].data.data(), i, last, ar);
+				}
+			}
+		});
+	}
+
+	template<typename T>
+	void gemv_batch_into(const matrix<T>& M, const std::vector<dense_vector<T> >& xs, std::vector<dense_vector<T> >& res, gemv_threads threads = gemv_threads::all())
+	{
+		_gemv_batch_into(M, xs, res, plain_arithmetic<T>(), threads.count);
+	}
+
+	template<typename T>
+	void gemv_batch_into(const matrix<T>& M, const std::vector<dense_vector<T> >& xs, std::vector<dense_vector<T> >& res, T mod, gemv_threads threads = gemv_threads::all())
+	{
+		_gemv_batch_into(M, xs, res, mod_arithmetic<T>{ mod }, threads.count);
+	}
+
+	template<typename T>
+	std::vector<dense_vector<T> > gemv_batch(const matrix<T>& M, const std::vector<dense_vector<T> >& xs, gemv_threads threads = gemv_threads::all())
+	{
+		std::vector<dense_vector<T> > res;
+		gemv_batch_into(M, xs, res, threads);
+		return res;
+	}
+
+	template<typename T>
+	std::vector<dense_vector<T> > gemv_batch(const matrix<T>& M, const std::vector<dense_vector<T> >& xs, T mod, gemv_threads threads = gemv_threads::all())
+	{
+		std::vector<dense_vector<T> > res;
+		gemv_batch_into(M, xs, res, mod, threads);
+		return res;
+	}
+
+	template<typename T>
+	std::ostream& operator<<(std::ostream& os, const dense_vector<T>& v)
+	{
+		for (const T& x : v)
+		{
+			os << x << " ";
+		}
+		return os << "\n";
+	}
+}
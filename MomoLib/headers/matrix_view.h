@@ -0,0 +1,533 @@
+#pragma once
+
+#include <type_traits>
+#include <algorithm>
+#include <iostream>
+
+#include "matrix.h"
+
+/*
+non-owning views over matrix data. Nothing is copied when view is created, sliced or transposed,
+so view must not outlive memory it refers to.
+matrix_view<T> looks at contiguous memory through row/column strides (external buffers, mmapped files, static_matrix data),
+matrix_rows_view<T> looks at matrix<T> which stores every row in separate vector.
+use matrix_view<const T> / matrix_rows_view<const T> for read-only access.
+Both have xsize(), ysize() and operator()(i, j), as matrix<T> does, so kernels below accept any mix of them
+*/
+namespace momo
+{
+	template<typename T>
+	class matrix_view
+	{
+		T* _data;
+		size_t _xsize, _ysize;
+		ptrdiff_t _row_stride, _col_stride;
+	public:
+		using value_type = typename std::remove_const<T>::type;
+
+		matrix_view()
+			: _data(nullptr), _xsize(0), _ysize(0), _row_stride(0), _col_stride(0) { }
+
+		// row-major dense buffer of xsize * ysize elements
+		matrix_view(T* data, size_t xsize, size_t ysize)
+			: _data(data), _xsize(xsize), _ysize(ysize), _row_stride((ptrdiff_t)ysize), _col_stride(1) { }
+
+		matrix_view(T* data, size_t xsize, size_t ysize, ptrdiff_t row_stride, ptrdiff_t col_stride)
+			: _data(data), _xsize(xsize), _ysize(ysize), _row_stride(row_stride), _col_stride(col_stride) { }
+
+		// mutable view is implicitly convertible to read-only one
+		template<typename U, typename = typename std::enable_if<std::is_same<const U, T>::value>::type>
+		matrix_view(const matrix_view<U>& other)
+			: _data(other.data()), _xsize(other.xsize()), _ysize(other.ysize()), _row_stride(other.row_stride()), _col_stride(other.col_stride()) { }
+
+		size_t xsize() const
+		{
+			return _xsize;
+		}
+
+		size_t ysize() const
+		{
+			return _ysize;
+		}
+
+		ptrdiff_t row_stride() const
+		{
+			return _row_stride;
+		}
+
+		ptrdiff_t col_stride() const
+		{
+			return _col_stride;
+		}
+
+		T* data() const
+		{
+			return _data;
+		}
+
+		T& operator()(size_t i, size_t j) const
+		{
+			return _data[(ptrdiff_t)i * _row_stride + (ptrdiff_t)j * _col_stride];
+		}
+
+		// view of [rows x cols] submatrix starting at (row, col)
+		matrix_view block(size_t row, size_t col, size_t rows, size_t cols) const
+		{
+			return matrix_view(&(*this)(row, col), rows, cols, _row_stride, _col_stride);
+		}
+
+		matrix_view row(size_t i) const
+		{
+			return block(i, 0, 1, _ysize);
+		}
+
+		matrix_view col(size_t j) const
+		{
+			return block(0, j, _xsize, 1);
+		}
+
+		// lazy transpose: only strides are swapped
+		matrix_view transposed() const
+		{
+			return matrix_view(_data, _ysize, _xsize, _col_stride, _row_stride);
+		}
+
+		matrix<value_type> to_matrix() const
+		{
+			matrix<value_type> res(_xsize, _ysize);
+			for (size_t i = 0; i < _xsize; i++)
+			{
+				for (size_t j = 0; j < _ysize; j++)
+				{
+					res.vec[i][j] = (*this)(i, j);
+				}
+			}
+			return res;
+		}
+	};
+
+	template<typename T>
+	class matrix_rows_view
+	{
+		using row_type = typename std::conditional<std::is_const<T>::value,
+			const std::vector<typename std::remove_const<T>::type>, std::vector<T> >::type;
+
+		row_type* _rows;
+		size_t _row0, _col0; // offset inside of viewed matrix
+		size_t _xsize, _ysize;
+		bool _transposed;
+
+		matrix_rows_view(row_type* rows, size_t row0, size_t col0, size_t xsize, size_t ysize, bool transposed)
+			: _rows(rows), _row0(row0), _col0(col0), _xsize(xsize), _ysize(ysize), _transposed(transposed) { }
+
+		template<typename U> friend class matrix_rows_view;
+	public:
+		using value_type = typename std::remove_const<T>::type;
+
+		matrix_rows_view()
+			: _rows(nullptr), _row0(0), _col0(0), _xsize(0), _ysize(0), _transposed(false) { }
+
+		template<typename M, typename = typename std::enable_if<std::is_same<typename std::remove_const<M>::type, matrix<value_type> >::value>::type>
+		explicit matrix_rows_view(M& src)
+			: _rows(src.vec.data()), _row0(0), _col0(0), _xsize(src.xsize()), _ysize(src.ysize()), _transposed(false) { }
+
+		template<typename U, typename = typename std::enable_if<std::is_same<const U, T>::value>::type>
+		matrix_rows_view(const matrix_rows_view<U>& other)
+			: _rows(other._rows), _row0(other._row0), _col0(other._col0), _xsize(other._xsize), _ysize(other._ysize), _transposed(other._transposed) { }
+
+		size_t xsize() const
+		{
+			return _xsize;
+		}
+
+		size_t ysize() const
+		{
+			return _ysize;
+		}
+
+		bool is_transposed() const
+		{
+			return _transposed;
+		}
+
+		T& operator()(size_t i, size_t j) const
+		{
+			return _transposed ? _rows[_row0 + j][_col0 + i] : _rows[_row0 + i][_col0 + j];
+		}
+
+		matrix_rows_view block(size_t row, size_t col, size_t rows, size_t cols) const
+		{
+			if (_transposed)
+				return matrix_rows_view(_rows, _row0 + col, _col0 + row, rows, cols, true);
+			else
+				return matrix_rows_view(_rows, _row0 + row, _col0 + col, rows, cols, false);
+		}
+
+		matrix_rows_view row(size_t i) const
+		{
+			return block(i, 0, 1, _ysize);
+		}
+
+		matrix_rows_view col(size_t j) const
+		{
+			return block(0, j, _xsize, 1);
+		}
+
+		matrix_rows_view transposed() const
+		{
+			return matrix_rows_view(_rows, _row0, _col0, _ysize, _xsize, !_transposed);
+		}
+
+		matrix<value_type> to_matrix() const
+		{
+			matrix<value_type> res(_xsize, _ysize);
+			for (size_t i = 0; i < _xsize; i++)
+			{
+				for (size_t j = 0; j < _ysize; j++)
+				{
+					res.vec[i][j] = (*this)(i, j);
+				}
+			}
+			return res;
+		}
+	};
+
+	template<typename T>
+	matrix_rows_view<T> view(matrix<T>& M)
+	{
+		return matrix_rows_view<T>(M);
+	}
+
+	template<typename T>
+	matrix_rows_view<const T> view(const matrix<T>& M)
+	{
+		return matrix_rows_view<const T>(M);
+	}
+
+	/*
+	adapts external row-major buffer without copying
+	*/
+	template<typename T>
+	matrix_view<T> view(T* data, size_t xsize, size_t ysize)
+	{
+		return matrix_view<T>(data, xsize, ysize);
+	}
+
+	template<typename T>
+	matrix_view<T> view(T* data, size_t xsize, size_t ysize, ptrdiff_t row_stride, ptrdiff_t col_stride)
+	{
+		return matrix_view<T>(data, xsize, ysize, row_stride, col_stride);
+	}
+
+	template<typename V>
+	struct is_matrix_view : std::false_type { };
+
+	template<typename T>
+	struct is_matrix_view<matrix_view<T> > : std::true_type { };
+
+	template<typename T>
+	struct is_matrix_view<matrix_rows_view<T> > : std::true_type { };
+
+	// enables generic kernels only if at least one of arguments is a view, matrix<T>-only calls use overloads from matrix.h
+	template<typename... Vs>
+	using enable_if_any_view = typename std::enable_if<(is_matrix_view<typename std::decay<Vs>::type>::value || ...)>::type;
+
+	template<typename V>
+	using view_value_type = typename std::decay<V>::type::value_type;
+
+	// operands of view kernels: views, matrices and lazy expressions of matrix.h
+	template<typename X>
+	struct is_view_operand : std::integral_constant<bool, is_matrix_view<X>::value || is_matrix_operand<X>::value> { };
+
+	// at least one operand is a view and all of them are matrix-like, so scalars never match
+	template<typename... Xs>
+	using enable_if_view_operands = typename std::enable_if<(is_matrix_view<typename std::decay<Xs>::type>::value || ...) &&
+		(is_view_operand<typename std::decay<Xs>::type>::value && ...)>::type;
+
+	/*
+	leaf of elementwise expression (see matrix_expr in matrix.h) which reads elements through view.
+	View is copied into expression, it is as cheap as pointer, so data must outlive expression
+	*/
+	template<typename V>
+	class matrix_view_expr : public matrix_expr<matrix_view_expr<V> >
+	{
+		V _v;
+	public:
+		using value_type = view_value_type<V>;
+
+		explicit matrix_view_expr(const V& v)
+			: _v(v) { }
+
+		size_t xsize() const
+		{
+			return _v.xsize();
+		}
+
+		size_t ysize() const
+		{
+			return _v.ysize();
+		}
+
+		value_type operator()(size_t i, size_t j) const
+		{
+			return _v(i, j);
+		}
+	};
+
+	// transposed or shifted view can read element (j, i) of matrix which is being assigned
+	template<typename V>
+	struct matrix_expr_in_place<matrix_view_expr<V> > : std::false_type { };
+
+	template<typename T>
+	matrix_view_expr<matrix_view<T> > _as_expr(const matrix_view<T>& v)
+	{
+		return matrix_view_expr<matrix_view<T> >(v);
+	}
+
+	template<typename T>
+	matrix_view_expr<matrix_rows_view<T> > _as_expr(const matrix_rows_view<T>& v)
+	{
+		return matrix_view_expr<matrix_rows_view<T> >(v);
+	}
+
+	/*
+	copies elements of src into dst of the same size
+	*/
+	template<typename Src, typename Dst, typename = enable_if_any_view<Src, Dst> >
+	void copy_into(const Src& src, Dst&& dst)
+	{
+		for (size_t i = 0; i < src.xsize(); i++)
+		{
+			for (size_t j = 0; j < src.ysize(); j++)
+			{
+				dst(i, j) = src(i, j);
+			}
+		}
+	}
+
+	/*
+	same blocked i-k-j kernel as mult_into for matrix<T>, but works through operator()(i, j) of any view.
+	res may be a temporary view, must not alias M1 or M2
+	*/
+	template<typename V1, typename V2, typename R, typename = enable_if_any_view<V1, V2, R> >
+	void mult_into(const V1& M1, const V2& M2, R&& res)
+	{
+		using T = view_value_type<R>;
+		const size_t n = M1.xsize(), m = M1.ysize(), p = M2.ysize();
+		for (size_t i = 0; i < n; i++)
+		{
+			for (size_t j = 0; j < p; j++)
+			{
+				res(i, j) = T();
+			}
+		}
+		for (size_t kk = 0; kk < m; kk += matrix_block_size)
+		{
+			const size_t kend = std::min(kk + matrix_block_size, m);
+			for (size_t jj = 0; jj < p; jj += matrix_block_size)
+			{
+				const size_t jend = std::min(jj + matrix_block_size, p);
+				for (size_t i = 0; i < n; i++)
+				{
+					for (size_t k = kk; k < kend; k++)
+					{
+						const T a = M1(i, k);
+						for (size_t j = jj; j < jend; j++)
+						{
+							res(i, j) += a * M2(k, j);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	template<typename V1, typename V2, typename R, typename T, typename = enable_if_any_view<V1, V2, R> >
+	void mult_into(const V1& M1, const V2& M2, R&& res, T mod)
+	{
+		const size_t n = M1.xsize(), m = M1.ysize(), p = M2.ysize();
+		for (size_t i = 0; i < n; i++)
+		{
+			for (size_t j = 0; j < p; j++)
+			{
+				res(i, j) = T();
+			}
+		}
+		for (size_t kk = 0; kk < m; kk += matrix_block_size)
+		{
+			const size_t kend = std::min(kk + matrix_block_size, m);
+			for (size_t jj = 0; jj < p; jj += matrix_block_size)
+			{
+				const size_t jend = std::min(jj + matrix_block_size, p);
+				for (size_t i = 0; i < n; i++)
+				{
+					for (size_t k = kk; k < kend; k++)
+					{
+						const T a = M1(i, k);
+						if (a == T()) continue;
+						for (size_t j = jj; j < jend; j++)
+						{
+							res(i, j) = (res(i, j) + a * M2(k, j) % mod) % mod;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	template<typename V1, typename V2, typename = enable_if_view_operands<V1, V2> >
+	matrix<view_value_type<V1> > operator*(const V1& M1, const V2& M2)
+	{
+		if (M1.ysize() != M2.xsize())
+		{
+			return matrix<view_value_type<V1> >(1, 1);
+		}
+		matrix<view_value_type<V1> > res(M1.xsize(), M2.ysize());
+		mult_into(M1, M2, res);
+		return res;
+	}
+
+	template<typename V1, typename V2, typename T, typename = enable_if_any_view<V1, V2> >
+	matrix<T> mult(const V1& M1, const V2& M2, T mod)
+	{
+		if (M1.ysize() != M2.xsize())
+		{
+			return matrix<T>(1, 1);
+		}
+		matrix<T> res(M1.xsize(), M2.ysize());
+		mult_into(M1, M2, res, mod);
+		return res;
+	}
+
+	/*
+	elementwise operators build lazy expressions of matrix.h, so views mix freely with matrices and other expressions.
+	Constraint is a non-type parameter, so these templates differ from the matrix-only operators of matrix.h
+	*/
+
+	template<typename X, typename Y, enable_if_view_operands<X, Y>* = nullptr>
+	matrix_binary_expr<_expr_t<X>, _expr_t<Y>, _expr_add> operator+(X&& M1, Y&& M2)
+	{
+		return matrix_binary_expr<_expr_t<X>, _expr_t<Y>, _expr_add>(_as_expr(std::forward<X>(M1)), _as_expr(std::forward<Y>(M2)));
+	}
+
+	template<typename X, typename Y, enable_if_view_operands<X, Y>* = nullptr>
+	matrix_binary_expr<_expr_t<X>, _expr_t<Y>, _expr_sub> operator-(X&& M1, Y&& M2)
+	{
+		return matrix_binary_expr<_expr_t<X>, _expr_t<Y>, _expr_sub>(_as_expr(std::forward<X>(M1)), _as_expr(std::forward<Y>(M2)));
+	}
+
+	template<typename V, enable_if_view_operands<V>* = nullptr>
+	matrix_scalar_expr<_expr_t<V>, _expr_add> operator+(V&& M, const view_value_type<V>& value)
+	{
+		return matrix_scalar_expr<_expr_t<V>, _expr_add>(_as_expr(std::forward<V>(M)), value);
+	}
+
+	template<typename V, enable_if_view_operands<V>* = nullptr>
+	matrix_scalar_expr<_expr_t<V>, _expr_sub> operator-(V&& M, const view_value_type<V>& value)
+	{
+		return matrix_scalar_expr<_expr_t<V>, _expr_sub>(_as_expr(std::forward<V>(M)), value);
+	}
+
+	template<typename V, enable_if_view_operands<V>* = nullptr>
+	matrix_scalar_expr<_expr_t<V>, _expr_mul> operator*(V&& M, const view_value_type<V>& value)
+	{
+		return matrix_scalar_expr<_expr_t<V>, _expr_mul>(_as_expr(std::forward<V>(M)), value);
+	}
+
+	template<typename V, enable_if_view_operands<V>* = nullptr>
+	matrix_scalar_expr<_expr_t<V>, _expr_rmul> operator*(const view_value_type<V>& value, V&& M)
+	{
+		return matrix_scalar_expr<_expr_t<V>, _expr_rmul>(_as_expr(std::forward<V>(M)), value);
+	}
+
+	template<typename V, enable_if_view_operands<V>* = nullptr>
+	matrix_scalar_expr<_expr_t<V>, _expr_div> operator/(V&& M, const view_value_type<V>& value)
+	{
+		return matrix_scalar_expr<_expr_t<V>, _expr_div>(_as_expr(std::forward<V>(M)), value);
+	}
+
+	// M += view goes through view expression, so it is evaluated into temporary if view aliases M
+	template<typename T, typename V, typename = typename std::enable_if<is_matrix_view<V>::value>::type>
+	matrix<T>& operator+=(matrix<T>& M, const V& v)
+	{
+		return M += matrix_view_expr<V>(v);
+	}
+
+	template<typename T, typename V, typename = typename std::enable_if<is_matrix_view<V>::value>::type>
+	matrix<T>& operator-=(matrix<T>& M, const V& v)
+	{
+		return M -= matrix_view_expr<V>(v);
+	}
+
+	// algorithms below need their own working copy of matrix anyway, so view is materialized once
+
+	template<typename V, typename = enable_if_any_view<V> >
+	matrix<view_value_type<V> > pow(const V& M, long long power)
+	{
+		return pow(M.to_matrix(), power);
+	}
+
+	template<typename V, typename T, typename = enable_if_any_view<V> >
+	matrix<T> pow(const V& M, long long power, T mod)
+	{
+		return pow(M.to_matrix(), power, mod);
+	}
+
+	template<typename V, typename T, typename = enable_if_any_view<V> >
+	std::vector<T> apply_pow(const V& M, long long power, std::vector<T> v)
+	{
+		return apply_pow(M.to_matrix(), power, std::move(v));
+	}
+
+	template<typename V, typename T, typename = enable_if_any_view<V> >
+	std::vector<T> apply_pow(const V& M, long long power, std::vector<T> v, T mod)
+	{
+		return apply_pow(M.to_matrix(), power, std::move(v), mod);
+	}
+
+	template<typename V1, typename V2, typename = enable_if_any_view<V1, V2> >
+	matrix<view_value_type<V1> > strassen(const V1& M1, const V2& M2, const strassen_options& options = strassen_options())
+	{
+		return strassen(M1.to_matrix(), M2.to_matrix(), options);
+	}
+
+	template<typename V1, typename V2, typename T, typename = enable_if_any_view<V1, V2> >
+	matrix<T> strassen(const V1& M1, const V2& M2, T mod, const strassen_options& options = strassen_options())
+	{
+		return strassen(M1.to_matrix(), M2.to_matrix(), mod, options);
+	}
+
+	template<typename V1, typename V2, typename = enable_if_any_view<V1, V2> >
+	bool operator==(const V1& M1, const V2& M2)
+	{
+		if (M1.xsize() != M2.xsize() || M1.ysize() != M2.ysize()) return false;
+		for (size_t i = 0; i < M1.xsize(); i++)
+		{
+			for (size_t j = 0; j < M1.ysize(); j++)
+			{
+				if (!(M1(i, j) == M2(i, j))) return false;
+			}
+		}
+		return true;
+	}
+
+	template<typename V1, typename V2, typename = enable_if_any_view<V1, V2> >
+	bool operator!=(const V1& M1, const V2& M2)
+	{
+		return !(M1 == M2);
+	}
+
+	template<typename V, typename = enable_if_any_view<V> >
+	std::ostream& operator<<(std::ostream& os, const V& M)
+	{
+		for (size_t i = 0; i < M.xsize(); i++)
+		{
+			for (size_t j = 0; j < M.ysize(); j++)
+			{
+				os << M(i, j) << " ";
+			}
+			os << "\n";
+		}
+		return os;
+	}
+}
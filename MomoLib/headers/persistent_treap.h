@@ -0,0 +1,499 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "treap.h"
+
+namespace momo
+{
+	/*
+	persistent treap (ordered multiset) with copy-on-write nodes. Copy of a treap (or snapshot()) shares all nodes
+	with the original and costs O(1). Nodes have atomic reference counters, node is modified in place only if it
+	is referenced once, otherwise it is copied, so update copies at most O(log n) nodes on its path and old
+	versions are never changed. Different versions can be read, updated and destroyed by different threads,
+	one version must not be updated concurrently. Random must be thread-safe if versions are updated by
+	different threads, Alloc copies must be able to free nodes of each other from any thread (as std::allocator)
+	*/
+	template<typename T, typename Priority = uint64_t, typename Random = random_int64, template<typename> class Alloc = std::allocator>
+	class persistent_treap
+	{
+		struct Node
+		{
+			T value;
+			Priority priority;
+			size_t sub_tree_size = 1;
+			Node* left = nullptr;
+			Node* right = nullptr;
+			std::atomic<uint32_t> refs{ 1 };
+
+			template<typename U>
+			Node(U&& value, Priority priority)
+				: value(std::forward<U>(value)), priority(priority) { }
+
+			// copy shares children of [node]
+			Node(const Node& node)
+				: value(node.value), priority(node.priority), sub_tree_size(node.sub_tree_size), left(node.left), right(node.right)
+			{
+				_retain(left);
+				_retain(right);
+			}
+
+			inline void _update()
+			{
+				sub_tree_size = 1 + _size(left) + _size(right);
+			}
+		};
+
+		using node_ptr = Node*;
+		using node_ptr_pair = std::pair<node_ptr, node_ptr>;
+		using allocator = Alloc<Node>;
+		using allocator_traits = std::allocator_traits<allocator>;
+
+		node_ptr _root = nullptr;
+		allocator _alloc;
+		std::vector<node_ptr_pair> _copies; // (copy, original) pairs made by current update, kept to avoid allocations
+
+		static inline size_t _size(node_ptr node)
+		{
+			return node == nullptr ? 0 : node->sub_tree_size;
+		}
+
+		static inline node_ptr _retain(node_ptr node)
+		{
+			if (node != nullptr) node->refs.fetch_add(1, std::memory_order_relaxed);
+			return node;
+		}
+
+		template<typename... Args>
+		node_ptr _construct_node(Args&&... args)
+		{
+			node_ptr node = allocator_traits::allocate(_alloc, 1);
+			try
+			{
+				allocator_traits::construct(_alloc, node, std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				allocator_traits::deallocate(_alloc, node, 1);
+				throw;
+			}
+			return node;
+		}
+
+		// drops one reference, nodes which are not referenced any more are destroyed without recursion
+		void _release(node_ptr node)
+		{
+			std::vector<node_ptr> st;
+			while (true)
+			{
+				if (node != nullptr && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					st.push_back(node->left);
+					st.push_back(node->right);
+					allocator_traits::destroy(_alloc, node);
+					allocator_traits::deallocate(_alloc, node, 1);
+				}
+				if (st.empty()) break;
+				node = st.back();
+				st.pop_back();
+			}
+		}
+
+		/*
+		takes owned reference to [node] and returns node which can be changed: the same node if nobody else
+		references it, its copy otherwise. Reference to the original is dropped by _update_root when update succeeds
+		*/
+		node_ptr _mutable(node_ptr node)
+		{
+			if (node->refs.load(std::memory_order_acquire) == 1) return node;
+			_copies.emplace_back(nullptr, node);
+			node_ptr copy = _construct_node(*node);
+			_copies.back().first = copy;
+			return copy;
+		}
+
+		/*
+		replaces root with update(root). Updates change one path of the tree and link changed nodes only after
+		everything below them is done, so if copy or comparison of T throws, tree is still untouched: copies are
+		freed and references to originals are kept, the exception is rethrown
+		*/
+		template<typename Update>
+		void _update_root(Update&& update)
+		{
+			_copies.clear();
+			node_ptr root;
+			try
+			{
+				root = update(_root);
+			}
+			catch (...)
+			{
+				for (const node_ptr_pair& copy : _copies) _release(copy.first);
+				_copies.clear();
+				throw;
+			}
+			_root = root;
+			for (const node_ptr_pair& copy : _copies) _release(copy.second);
+			_copies.clear();
+		}
+
+		/*
+		all functions below take owned references to their tree arguments and return owned references
+		*/
+
+		// values less or equal to K go to the first tree, others to the second
+		node_ptr_pair _split(node_ptr root, const T& K)
+		{
+			if (root == nullptr) return { nullptr, nullptr };
+			root = _mutable(root);
+			if (K < root->value)
+			{
+				node_ptr_pair sub_trees = _split(root->left, K);
+				root->left = sub_trees.second;
+				root->_update();
+				return { sub_trees.first, root };
+			}
+			node_ptr_pair sub_trees = _split(root->right, K);
+			root->right = sub_trees.first;
+			root->_update();
+			return { root, sub_trees.second };
+		}
+
+		node_ptr _merge(node_ptr tree_left, node_ptr tree_right)
+		{
+			if (tree_left == nullptr) return tree_right;
+			if (tree_right == nullptr) return tree_left;
+			if (tree_left->priority < tree_right->priority)
+			{
+				tree_left = _mutable(tree_left);
+				tree_left->right = _merge(tree_left->right, tree_right);
+				tree_left->_update();
+				return tree_left;
+			}
+			tree_right = _mutable(tree_right);
+			tree_right->left = _merge(tree_left, tree_right->left);
+			tree_right->_update();
+			return tree_right;
+		}
+
+		node_ptr _insert(node_ptr root, node_ptr node)
+		{
+			if (root == nullptr) return node;
+			if (root->priority < node->priority)
+			{
+				root = _mutable(root);
+				// equal values go right as in _split, so duplicates do not form a chain
+				if (node->value < root->value) root->left = _insert(root->left, node);
+				else root->right = _insert(root->right, node);
+				root->_update();
+				return root;
+			}
+			node_ptr_pair sub_trees = _split(root, node->value);
+			node->left = sub_trees.first;
+			node->right = sub_trees.second;
+			node->_update();
+			return node;
+		}
+
+		// [root] must contain [value]
+		node_ptr _erase(node_ptr root, const T& value)
+		{
+			root = _mutable(root);
+			if (root->value < value)
+			{
+				root->right = _erase(root->right, value);
+			}
+			else if (value < root->value)
+			{
+				root->left = _erase(root->left, value);
+			}
+			else
+			{
+				node_ptr res = _merge(root->left, root->right);
+				root->left = root->right = nullptr;
+				_release(root);
+				return res;
+			}
+			root->_update();
+			return root;
+		}
+
+		node_ptr _find(const T& value) const
+		{
+			node_ptr node = _root;
+			while (node != nullptr)
+			{
+				if (node->value < value) node = node->right;
+				else if (value < node->value) node = node->left;
+				else return node;
+			}
+			return nullptr;
+		}
+
+		void _insert_node(node_ptr node)
+		{
+			try
+			{
+				_update_root([&](node_ptr root) { return _insert(root, node); });
+			}
+			catch (...)
+			{
+				// node is linked only after split has succeeded, so it is still alone
+				_release(node);
+				throw;
+			}
+		}
+
+		template<typename SortedIt>
+		node_ptr _build(const SortedIt& first, const SortedIt& last)
+		{
+			std::vector<node_ptr> st;
+			node_ptr root = nullptr;
+			for (SortedIt it = first; it != last; it++)
+			{
+				const T& value = *it;
+				node_ptr current = _construct_node(value, treap_priority<Priority, Random>(value));
+				node_ptr last_popped = nullptr;
+				while (!st.empty())
+				{
+					if (st.back()->priority < current->priority)
+					{
+						st.back()->right = current;
+						break;
+					}
+					last_popped = st.back();
+					last_popped->_update();
+					st.pop_back();
+				}
+				if (st.empty()) root = current;
+				current->left = last_popped;
+				st.push_back(current);
+			}
+			while (!st.empty())
+			{
+				st.back()->_update();
+				st.pop_back();
+			}
+			return root;
+		}
+	public:
+		using value_type = T;
+		using persistent_treap_node = Node;
+
+		persistent_treap() = default;
+
+		template<typename SortedIt>
+		persistent_treap(const SortedIt& first, const SortedIt& last)
+		{
+			_root = _build(first, last);
+		}
+
+		// O(1), nodes are shared until one of the versions changes them
+		persistent_treap(const persistent_treap& tr)
+			: _root(_retain(tr._root)), _alloc(tr._alloc) { }
+
+		persistent_treap(persistent_treap&& tr) noexcept
+			: _root(tr._root), _alloc(tr._alloc)
+		{
+			tr._root = nullptr;
+		}
+
+		persistent_treap& operator=(const persistent_treap& tr)
+		{
+			node_ptr root = _retain(tr._root);
+			_release(_root);
+			_root = root;
+			return *this;
+		}
+
+		persistent_treap& operator=(persistent_treap&& tr) noexcept
+		{
+			if (this != &tr)
+			{
+				_release(_root);
+				_root = tr._root;
+				tr._root = nullptr;
+			}
+			return *this;
+		}
+
+		~persistent_treap()
+		{
+			_release(_root);
+		}
+
+		// read-only version of current state, later updates of this treap do not change it
+		inline persistent_treap snapshot() const
+		{
+			return *this;
+		}
+
+		inline size_t size() const noexcept
+		{
+			return _size(_root);
+		}
+
+		inline bool empty() const noexcept
+		{
+			return _root == nullptr;
+		}
+
+		inline void clear()
+		{
+			_release(_root);
+			_root = nullptr;
+		}
+
+		// if copy or comparison of T throws, treap is not changed
+		inline void insert(const value_type& value)
+		{
+			_insert_node(_construct_node(value, treap_priority<Priority, Random>(value)));
+		}
+
+		inline void insert(value_type&& value)
+		{
+			Priority priority = treap_priority<Priority, Random>(value);
+			_insert_node(_construct_node(std::move(value), priority));
+		}
+
+		// erases one value equal to [value], returns false if there is none
+		inline bool erase(const value_type& value)
+		{
+			if (_find(value) == nullptr) return false;
+			_update_root([&](node_ptr root) { return _erase(root, value); });
+			return true;
+		}
+
+		// returns pointer to value equal to [value] or nullptr, it stays valid while this version is not changed
+		inline const value_type* find(const value_type& value) const
+		{
+			node_ptr node = _find(value);
+			return node == nullptr ? nullptr : &node->value;
+		}
+
+		inline bool contains(const value_type& value) const
+		{
+			return _find(value) != nullptr;
+		}
+
+		inline size_t count(const value_type& value) const
+		{
+			return order_of_key_upper(value) - order_of_key(value);
+		}
+
+		inline const value_type& left() const
+		{
+			node_ptr node = _root;
+			while (node->left != nullptr) node = node->left;
+			return node->value;
+		}
+
+		inline const value_type& right() const
+		{
+			node_ptr node = _root;
+			while (node->right != nullptr) node = node->right;
+			return node->value;
+		}
+
+		/*
+		returns [index]-th smallest value, index must be less than size()
+		*/
+		inline const value_type& nth(size_t index) const
+		{
+			node_ptr node = _root;
+			while (true)
+			{
+				size_t left_size = _size(node->left);
+				if (index < left_size)
+				{
+					node = node->left;
+				}
+				else if (index == left_size)
+				{
+					return node->value;
+				}
+				else
+				{
+					index -= left_size + 1;
+					node = node->right;
+				}
+			}
+		}
+
+		// returns amount of values which are less or equal to [value]
+		inline size_t order_of_key_upper(const value_type& value) const
+		{
+			size_t order = 0;
+			node_ptr node = _root;
+			while (node != nullptr)
+			{
+				if (value < node->value)
+				{
+					node = node->left;
+				}
+				else
+				{
+					order += 1 + _size(node->left);
+					node = node->right;
+				}
+			}
+			return order;
+		}
+
+		// returns amount of values which are less than [value]
+		inline size_t order_of_key(const value_type& value) const
+		{
+			size_t order = 0;
+			node_ptr node = _root;
+			while (node != nullptr)
+			{
+				if (node->value < value)
+				{
+					order += 1 + _size(node->left);
+					node = node->right;
+				}
+				else
+				{
+					node = node->left;
+				}
+			}
+			return order;
+		}
+
+		// calls func(value) for every value in order
+		template<typename Func>
+		void apply_visitor(Func&& func) const
+		{
+			std::vector<node_ptr> st;
+			node_ptr node = _root;
+			while (node != nullptr || !st.empty())
+			{
+				while (node != nullptr)
+				{
+					st.push_back(node);
+					node = node->left;
+				}
+				node = st.back();
+				st.pop_back();
+				func(node->value);
+				node = node->right;
+			}
+		}
+
+		inline void swap(persistent_treap& tr)
+		{
+			std::swap(_root, tr._root);
+			std::swap(_alloc, tr._alloc);
+		}
+	};
+
+	template<typename T, typename P, typename R, template<typename> class A>
+	inline void swap(persistent_treap<T, P, R, A>& tr1, persistent_treap<T, P, R, A>& tr2)
+	{
+		tr1.swap(tr2);
+	}
+}
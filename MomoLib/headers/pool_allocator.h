@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace momo
+{
+	/*
+	memory blocks of pools joined by adopt(). Blocks are freed only when the last pool of the group is destroyed,
+	pools reference the group and the group knows its pools by plain pointers, so references never form a cycle
+	*/
+	struct _pool_state;
+
+	struct _pool_memory
+	{
+		std::vector<std::pair<void*, size_t> > blocks; // block and its alignment
+		std::vector<_pool_state*> states;
+
+		_pool_memory() = default;
+		_pool_memory(const _pool_memory&) = delete;
+		_pool_memory& operator=(const _pool_memory&) = delete;
+
+		~_pool_memory()
+		{
+			release();
+		}
+
+		void* add_block(size_t size, size_t align)
+		{
+			blocks.reserve(blocks.size() + 1);
+			void* block = ::operator new(size, std::align_val_t(align));
+			blocks.emplace_back(block, align);
+			return block;
+		}
+
+		void release() noexcept
+		{
+			for (const auto& block : blocks)
+			{
+				::operator delete(block.first, std::align_val_t(block.second));
+			}
+			blocks.clear();
+		}
+	};
+
+	/*
+	pool of equal-sized slots. Slots are handed out from contiguous blocks which grow geometrically, freed slots go
+	to intrusive free list (as in MxEngine::PoolAllocator: free slot stores link to the next free slot).
+	Blocks belong to _pool_memory, so free list can also hold slots of blocks of joined pools
+	*/
+	class _pool_bucket
+	{
+		void* _free_list = nullptr;
+		unsigned char* _bump = nullptr; // next never used slot of the last block
+		unsigned char* _bump_end = nullptr;
+		size_t _next_block_size;
+	public:
+		static constexpr size_t max_block_size = 1 << 16;
+
+		const size_t slot_size;
+		const size_t slot_align;
+		size_t allocated = 0;
+
+		_pool_bucket(size_t slot_size, size_t slot_align, size_t first_block_size)
+			: _next_block_size(first_block_size), slot_size(slot_size), slot_align(slot_align) { }
+
+		_pool_bucket(const _pool_bucket&) = delete;
+		_pool_bucket& operator=(const _pool_bucket&) = delete;
+
+		void* allocate(_pool_memory& memory)
+		{
+			void* res;
+			if (_free_list != nullptr)
+			{
+				res = _free_list;
+				_free_list = *static_cast<void**>(res);
+			}
+			else
+			{
+				if (_bump == _bump_end)
+				{
+					size_t size = _next_block_size;
+					_bump = static_cast<unsigned char*>(memory.add_block(size * slot_size, slot_align));
+					_bump_end = _bump + size * slot_size;
+					if (_next_block_size < max_block_size) _next_block_size *= 2;
+				}
+				res = _bump;
+				_bump += slot_size;
+			}
+			allocated++;
+			return res;
+		}
+
+		void deallocate(void* ptr) noexcept
+		{
+			*static_cast<void**>(ptr) = _free_list;
+			_free_list = ptr;
+			allocated--;
+		}
+
+		// forgets all slots, must be called when blocks of its memory are freed
+		void reset() noexcept
+		{
+			_free_list = nullptr;
+			_bump = _bump_end = nullptr;
+			allocated = 0;
+		}
+	};
+
+	/*
+	pool shared by all copies of pool_allocator, including rebound ones. Every (size, alignment) of objects
+	gets its own bucket, so rebound copies allocate from and free into the same pool
+	*/
+	struct _pool_state
+	{
+		std::vector<std::unique_ptr<_pool_bucket> > buckets;
+		std::shared_ptr<_pool_memory> memory;
+		size_t first_block_size;
+
+		explicit _pool_state(size_t first_block_size)
+			: memory(std::make_shared<_pool_memory>()), first_block_size(first_block_size)
+		{
+			memory->states.push_back(this);
+		}
+
+		_pool_state(const _pool_state&) = delete;
+		_pool_state& operator=(const _pool_state&) = delete;
+
+		~_pool_state()
+		{
+			std::vector<_pool_state*>& states = memory->states;
+			states.erase(std::find(states.begin(), states.end(), this));
+		}
+
+		_pool_bucket* bucket(size_t slot_size, size_t slot_align)
+		{
+			for (const auto& b : buckets)
+			{
+				if (b->slot_size == slot_size && b->slot_align == slot_align) return b.get();
+			}
+			buckets.push_back(std::make_unique<_pool_bucket>(slot_size, slot_align, first_block_size));
+			return buckets.back().get();
+		}
+
+		// moves blocks and pools of the smaller memory group to the bigger one, all pools of both groups then share it
+		void join(_pool_state& other)
+		{
+			std::shared_ptr<_pool_memory> to = memory, from = other.memory;
+			if (to == from) return;
+			if (to->states.size() < from->states.size()) std::swap(to, from);
+			to->blocks.reserve(to->blocks.size() + from->blocks.size());
+			to->states.reserve(to->states.size() + from->states.size());
+			to->blocks.insert(to->blocks.end(), from->blocks.begin(), from->blocks.end());
+			from->blocks.clear();
+			for (_pool_state* state : from->states)
+			{
+				state->memory = to;
+				to->states.push_back(state);
+			}
+			from->states.clear();
+		}
+	};
+
+	/*
+	STL-compatible pool allocator for node-based containers. Single objects are taken from _pool_bucket of their size,
+	so allocate / deallocate are O(1) and neighbour nodes stay close in memory. Requests for more than one object are
+	forwarded to std::allocator.
+	Copies of allocator share the same pool, rebound copies too (A(B(a)) == a), so containers which allocate through
+	temporary rebound allocators (std::list, MSVC debug iterator proxies) work. Copy of container gets its own pool
+	(select_on_container_copy_construction). release() frees all blocks in O(blocks) without visiting objects,
+	so container of trivially destructible nodes can be cleared without traversal. Can be passed to treap as Alloc
+	template parameter
+	*/
+	template<typename T>
+	class pool_allocator
+	{
+		template<typename U>
+		friend class pool_allocator;
+
+		// free slot stores pointer to the next one
+		static constexpr size_t _slot_align = alignof(T) > alignof(void*) ? alignof(T) : alignof(void*);
+		static constexpr size_t _slot_size = ((sizeof(T) > sizeof(void*) ? sizeof(T) : sizeof(void*)) + _slot_align - 1) / _slot_align * _slot_align;
+
+		std::shared_ptr<_pool_state> _state;
+		_pool_bucket* _bucket;
+	public:
+		static constexpr size_t default_block_size = 64;
+		static constexpr size_t max_block_size = _pool_bucket::max_block_size;
+
+		using value_type = T;
+		using size_type = size_t;
+		using difference_type = std::ptrdiff_t;
+		using propagate_on_container_copy_assignment = std::false_type;
+		using propagate_on_container_move_assignment = std::true_type;
+		using propagate_on_container_swap = std::true_type;
+		using is_always_equal = std::false_type;
+
+		template<typename U>
+		struct rebind
+		{
+			using other = pool_allocator<U>;
+		};
+
+		// [first_block_size] is amount of objects in the first block, every next block is twice bigger
+		explicit pool_allocator(size_t first_block_size = default_block_size)
+			: _state(std::make_shared<_pool_state>(first_block_size == 0 ? 1 : first_block_size)),
+			_bucket(_state->bucket(_slot_size, _slot_align)) { }
+
+		// there are no move operations: moved-from container must still be able to allocate
+		pool_allocator(const pool_allocator&) = default;
+		pool_allocator& operator=(const pool_allocator&) = default;
+
+		// rebound allocator shares the pool and uses bucket of its own object size
+		template<typename U>
+		pool_allocator(const pool_allocator<U>& other)
+			: _state(other._state), _bucket(_state->bucket(_slot_size, _slot_align)) { }
+
+		pool_allocator select_on_container_copy_construction() const
+		{
+			return pool_allocator(_state->first_block_size);
+		}
+
+		T* allocate(size_t n)
+		{
+			if (n != 1) return std::allocator<T>().allocate(n);
+			return static_cast<T*>(_bucket->allocate(*_state->memory));
+		}
+
+		void deallocate(T* ptr, size_t n) noexcept
+		{
+			if (n != 1)
+			{
+				std::allocator<T>().deallocate(ptr, n);
+				return;
+			}
+			_bucket->deallocate(ptr);
+		}
+
+		// amount of objects of all sizes which are currently allocated from pool
+		size_t allocated() const noexcept
+		{
+			size_t res = 0;
+			for (const auto& b : _state->buckets) res += b->allocated;
+			return res;
+		}
+
+		// amount of memory blocks of this pool and pools joined with it by adopt()
+		size_t block_count() const noexcept
+		{
+			return _state->memory->blocks.size();
+		}
+
+		// true if no other allocator shares this pool and it is not joined with other pools
+		bool unique() const noexcept
+		{
+			return _state.use_count() == 1 && _state->memory->states.size() == 1;
+		}
+
+		/*
+		joins memory of pool of [other] with this one, blocks of both are freed when the last of the joined pools
+		is destroyed. Must be called when objects allocated by [other] are moved into container which uses this
+		allocator, e.g. when two treaps are merged. Pools can adopt each other in any order, memory is merged
+		instead of referenced, so it is never leaked by a cycle
+		*/
+		void adopt(const pool_allocator& other)
+		{
+			_state->join(*other._state);
+		}
+
+		/*
+		frees all blocks of this pool and pools joined with it at once in O(blocks). Objects are not destroyed,
+		all of them must be already destroyed or trivially destructible and no longer used
+		*/
+		void release() noexcept
+		{
+			for (_pool_state* state : _state->memory->states)
+			{
+				for (const auto& b : state->buckets) b->reset();
+			}
+			_state->memory->release();
+		}
+
+		template<typename U>
+		bool operator==(const pool_allocator<U>& other) const noexcept
+		{
+			return _state == other._state;
+		}
+
+		template<typename U>
+		bool operator!=(const pool_allocator<U>& other) const noexcept
+		{
+			return _state != other._state;
+		}
+	};
+}
@@ -0,0 +1,621 @@
+#pragma once
+
+#include <vector>
+#include <tuple>
+#include <thread>
+#include <algorithm>
+#include <limits>
+#include <iostream>
+
+#include "matrix.h"
+
+/*
+compressed sparse row (CSR) and compressed sparse column (CSC) matrices. Only non-zero values are stored,
+so memory and work are proportional to amount of non-zeros instead of xsize * ysize.
+Both convert from / to dense matrix<T>. Products: sparse * vector (parallel), sparse * sparse, sparse * dense, pow and apply_pow
+*/
+namespace momo
+{
+	template<typename T>
+	class csc_matrix;
+
+	// products with less non-zeros than this are computed in one thread even if more threads are requested
+	constexpr size_t sparse_parallel_threshold = 1 << 16;
+
+	inline size_t sparse_default_threads()
+	{
+		size_t threads = std::thread::hardware_concurrency();
+		return threads == 0 ? 1 : threads;
+	}
+
+	template<typename T>
+	class csr_matrix
+	{
+		size_t size_x, size_y;
+	public:
+		using value_type = T;
+
+		// row i occupies [row_ptr[i]; row_ptr[i + 1]) in col_index and values, columns in every row are sorted
+		std::vector<size_t> row_ptr;
+		std::vector<size_t> col_index;
+		std::vector<T> values;
+
+		csr_matrix()
+			: size_x(0), size_y(0), row_ptr(1, 0) { }
+
+		// empty (all-zero) matrix of given size
+		csr_matrix(size_t xsize, size_t ysize)
+			: size_x(xsize), size_y(ysize), row_ptr(xsize + 1, 0) { }
+
+		explicit csr_matrix(const matrix<T>& M)
+			: size_x(M.xsize()), size_y(M.ysize()), row_ptr(1, 0)
+		{
+			row_ptr.reserve(size_x + 1);
+			for (size_t i = 0; i < size_x; i++)
+			{
+				for (size_t j = 0; j < size_y; j++)
+				{
+					if (M.vec[i][j] == T()) continue;
+					col_index.push_back(j);
+					values.push_back(M.vec[i][j]);
+				}
+				row_ptr.push_back(col_index.size());
+			}
+		}
+
+		/*
+		builds matrix from (row, col, value) entries in any order. Duplicate entries are summed, zeros are dropped
+		*/
+		static csr_matrix from_triplets(size_t xsize, size_t ysize, std::vector<std::tuple<size_t, size_t, T> > entries)
+		{
+			std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b)
+			{
+				return std::get<0>(a) != std::get<0>(b) ? std::get<0>(a) < std::get<0>(b) : std::get<1>(a) < std::get<1>(b);
+			});
+			csr_matrix res(xsize, ysize);
+			res.col_index.reserve(entries.size());
+			res.values.reserve(entries.size());
+			size_t row = 0;
+			for (size_t e = 0; e < entries.size(); )
+			{
+				size_t i = std::get<0>(entries[e]), j = std::get<1>(entries[e]);
+				T value = std::get<2>(entries[e]);
+				for (e++; e < entries.size() && std::get<0>(entries[e]) == i && std::get<1>(entries[e]) == j; e++)
+				{
+					value += std::get<2>(entries[e]);
+				}
+				if (value == T()) continue;
+				for (; row < i; row++) res.row_ptr[row + 1] = res.col_index.size();
+				res.col_index.push_back(j);
+				res.values.push_back(value);
+			}
+			for (; row < xsize; row++) res.row_ptr[row + 1] = res.col_index.size();
+			return res;
+		}
+
+		size_t xsize() const
+		{
+			return size_x;
+		}
+
+		size_t ysize() const
+		{
+			return size_y;
+		}
+
+		size_t nonzeros() const
+		{
+			return values.size();
+		}
+
+		// returns element value, T() if it is not stored. O(log(non-zeros in row))
+		T operator()(size_t i, size_t j) const
+		{
+			auto begin = col_index.begin() + row_ptr[i], end = col_index.begin() + row_ptr[i + 1];
+			auto it = std::lower_bound(begin, end, j);
+			return (it != end && *it == j) ? values[it - col_index.begin()] : T();
+		}
+
+		matrix<T> to_matrix() const
+		{
+			matrix<T> res(size_x, size_y);
+			for (size_t i = 0; i < size_x; i++)
+			{
+				for (size_t k = row_ptr[i]; k < row_ptr[i + 1]; k++)
+				{
+					res.vec[i][col_index[k]] = values[k];
+				}
+			}
+			return res;
+		}
+
+		/*
+		CSC of the same matrix, O(non-zeros + ysize)
+		*/
+		csc_matrix<T> to_csc() const
+		{
+			csc_matrix<T> res(size_x, size_y);
+			res.row_index.resize(nonzeros());
+			res.values.resize(nonzeros());
+			for (size_t k = 0; k < nonzeros(); k++)
+			{
+				res.col_ptr[col_index[k] + 1]++;
+			}
+			for (size_t j = 0; j < size_y; j++)
+			{
+				res.col_ptr[j + 1] += res.col_ptr[j];
+			}
+			std::vector<size_t> next(res.col_ptr.begin(), res.col_ptr.end() - 1);
+			for (size_t i = 0; i < size_x; i++)
+			{
+				for (size_t k = row_ptr[i]; k < row_ptr[i + 1]; k++)
+				{
+					size_t pos = next[col_index[k]]++;
+					res.row_index[pos] = i;
+					res.values[pos] = values[k];
+				}
+			}
+			return res;
+		}
+
+		csr_matrix transposed() const
+		{
+			csc_matrix<T> csc = to_csc();
+			csr_matrix res(size_y, size_x);
+			res.row_ptr = std::move(csc.col_ptr);
+			res.col_index = std::move(csc.row_index);
+			res.values = std::move(csc.values);
+			return res;
+		}
+
+		bool operator==(const csr_matrix& M) const
+		{
+			return size_x == M.size_x && size_y == M.size_y && row_ptr == M.row_ptr && col_index == M.col_index && values == M.values;
+		}
+
+		bool operator!=(const csr_matrix& M) const
+		{
+			return !(*this == M);
+		}
+	};
+
+	template<typename T>
+	class csc_matrix
+	{
+		size_t size_x, size_y;
+	public:
+		using value_type = T;
+
+		// column j occupies [col_ptr[j]; col_ptr[j + 1]) in row_index and values, rows in every column are sorted
+		std::vector<size_t> col_ptr;
+		std::vector<size_t> row_index;
+		std::vector<T> values;
+
+		csc_matrix()
+			: size_x(0), size_y(0), col_ptr(1, 0) { }
+
+		csc_matrix(size_t xsize, size_t ysize)
+			: size_x(xsize), size_y(ysize), col_ptr(ysize + 1, 0) { }
+
+		explicit csc_matrix(const matrix<T>& M)
+			: size_x(M.xsize()), size_y(M.ysize()), col_ptr(1, 0)
+		{
+			col_ptr.reserve(size_y + 1);
+			for (size_t j = 0; j < size_y; j++)
+			{
+				for (size_t i = 0; i < size_x; i++)
+				{
+					if (M.vec[i][j] == T()) continue;
+					row_index.push_back(i);
+					values.push_back(M.vec[i][j]);
+				}
+				col_ptr.push_back(row_index.size());
+			}
+		}
+
+		size_t xsize() const
+		{
+			return size_x;
+		}
+
+		size_t ysize() const
+		{
+			return size_y;
+		}
+
+		size_t nonzeros() const
+		{
+			return values.size();
+		}
+
+		T operator()(size_t i, size_t j) const
+		{
+			auto begin = row_index.begin() + col_ptr[j], end = row_index.begin() + col_ptr[j + 1];
+			auto it = std::lower_bound(begin, end, i);
+			return (it != end && *it == i) ? values[it - row_index.begin()] : T();
+		}
+
+		matrix<T> to_matrix() const
+		{
+			matrix<T> res(size_x, size_y);
+			for (size_t j = 0; j < size_y; j++)
+			{
+				for (size_t k = col_ptr[j]; k < col_ptr[j + 1]; k++)
+				{
+					res.vec[row_index[k]][j] = values[k];
+				}
+			}
+			return res;
+		}
+
+		/*
+		CSR of the same matrix. CSC of A has exactly the layout of CSR of A^T, so transpose is reused
+		*/
+		csr_matrix<T> to_csr() const
+		{
+			csr_matrix<T> at(size_y, size_x);
+			at.row_ptr = col_ptr;
+			at.col_index = row_index;
+			at.values = values;
+			return at.transposed();
+		}
+
+		bool operator==(const csc_matrix& M) const
+		{
+			return size_x == M.size_x && size_y == M.size_y && col_ptr == M.col_ptr && row_index == M.row_index && values == M.values;
+		}
+
+		bool operator!=(const csc_matrix& M) const
+		{
+			return !(*this == M);
+		}
+	};
+
+	/*
+	splits rows of A into [threads] chunks with roughly equal amount of non-zeros and calls func(row_begin, row_end, chunk) for each of them.
+	the calling thread processes the first chunk itself
+	*/
+	template<typename T, typename Func>
+	void _sparse_parallel_rows(const csr_matrix<T>& A, size_t threads, Func&& func)
+	{
+		const size_t n = A.xsize();
+		if (threads <= 1 || n < 2 || A.nonzeros() < sparse_parallel_threshold)
+		{
+			func(size_t(0), n, size_t(0));
+			return;
+		}
+		threads = std::min(threads, n);
+		std::vector<size_t> bounds(threads + 1, n);
+		bounds[0] = 0;
+		for (size_t t = 1; t < threads; t++)
+		{
+			size_t target = A.nonzeros() * t / threads;
+			bounds[t] = std::lower_bound(A.row_ptr.begin(), A.row_ptr.end() - 1, target) - A.row_ptr.begin();
+			bounds[t] = std::max(bounds[t], bounds[t - 1]);
+		}
+		std::vector<std::thread> workers;
+		workers.reserve(threads - 1);
+		for (size_t t = 1; t < threads; t++)
+		{
+			workers.emplace_back([&func, &bounds, t]() { func(bounds[t], bounds[t + 1], t); });
+		}
+		func(bounds[0], bounds[1], size_t(0));
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	template<typename T, typename Arithmetic>
+	void _spmv_into(const csr_matrix<T>& A, const std::vector<T>& x, std::vector<T>& res, const Arithmetic& ar, size_t threads)
+	{
+		_sparse_parallel_rows(A, threads, [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				T sum = T();
+				for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+				{
+					sum = ar.add(sum, ar.mul(A.values[k], x[A.col_index[k]]));
+				}
+				res[i] = sum;
+			}
+		});
+	}
+
+	/*
+	sparse matrix-vector product into preallocated res (res.size() == A.xsize(), must not alias x).
+	rows are shared between [threads] threads, small matrices are always processed sequentially
+	*/
+	template<typename T>
+	void spmv_into(const csr_matrix<T>& A, const std::vector<T>& x, std::vector<T>& res, size_t threads)
+	{
+		_spmv_into(A, x, res, plain_arithmetic<T>(), threads);
+	}
+
+	template<typename T>
+	void spmv_into(const csr_matrix<T>& A, const std::vector<T>& x, std::vector<T>& res, T mod, size_t threads)
+	{
+		_spmv_into(A, x, res, mod_arithmetic<T>{ mod }, threads);
+	}
+
+	/*
+	returns A * x, empty vector if sizes do not match
+	*/
+	template<typename T>
+	std::vector<T> spmv(const csr_matrix<T>& A, const std::vector<T>& x)
+	{
+		if (A.ysize() != x.size()) return std::vector<T>();
+		std::vector<T> res(A.xsize());
+		spmv_into(A, x, res, sparse_default_threads());
+		return res;
+	}
+
+	template<typename T>
+	std::vector<T> spmv(const csr_matrix<T>& A, const std::vector<T>& x, T mod)
+	{
+		if (A.ysize() != x.size()) return std::vector<T>();
+		std::vector<T> res(A.xsize());
+		spmv_into(A, x, res, mod, sparse_default_threads());
+		return res;
+	}
+
+	/*
+	CSC product scatters every column into result, so it is sequential
+	*/
+	template<typename T>
+	std::vector<T> spmv(const csc_matrix<T>& A, const std::vector<T>& x)
+	{
+		if (A.ysize() != x.size()) return std::vector<T>();
+		std::vector<T> res(A.xsize());
+		for (size_t j = 0; j < A.ysize(); j++)
+		{
+			if (x[j] == T()) continue;
+			for (size_t k = A.col_ptr[j]; k < A.col_ptr[j + 1]; k++)
+			{
+				res[A.row_index[k]] += A.values[k] * x[j];
+			}
+		}
+		return res;
+	}
+
+	template<typename T>
+	std::vector<T> operator*(const csr_matrix<T>& A, const std::vector<T>& x)
+	{
+		return spmv(A, x);
+	}
+
+	template<typename T>
+	std::vector<T> operator*(const csc_matrix<T>& A, const std::vector<T>& x)
+	{
+		return spmv(A, x);
+	}
+
+	/*
+	Gustavson row-by-row product with dense accumulator per thread. Every chunk of rows of A produces its own part of result,
+	parts are concatenated at the end. Cancelled values (exact zeros) are dropped
+	*/
+	template<typename T, typename Arithmetic>
+	csr_matrix<T> _spgemm(const csr_matrix<T>& A, const csr_matrix<T>& B, const Arithmetic& ar, size_t threads)
+	{
+		struct part
+		{
+			std::vector<size_t> row_nnz;
+			std::vector<size_t> col_index;
+			std::vector<T> values;
+		};
+		const size_t chunks = (threads <= 1 || A.nonzeros() < sparse_parallel_threshold) ? 1 : std::min(threads, std::max<size_t>(A.xsize(), 1));
+		std::vector<part> parts(chunks);
+		std::vector<size_t> first_row(chunks, 0);
+
+		_sparse_parallel_rows(A, chunks, [&](size_t begin, size_t end, size_t chunk)
+		{
+			part& p = parts[chunk];
+			first_row[chunk] = begin;
+			std::vector<T> acc(B.ysize());
+			std::vector<size_t> marker(B.ysize(), std::numeric_limits<size_t>::max());
+			std::vector<size_t> touched;
+			for (size_t i = begin; i < end; i++)
+			{
+				touched.clear();
+				for (size_t ka = A.row_ptr[i]; ka < A.row_ptr[i + 1]; ka++)
+				{
+					const size_t k = A.col_index[ka];
+					const T& a = A.values[ka];
+					for (size_t kb = B.row_ptr[k]; kb < B.row_ptr[k + 1]; kb++)
+					{
+						const size_t j = B.col_index[kb];
+						if (marker[j] != i)
+						{
+							marker[j] = i;
+							acc[j] = T();
+							touched.push_back(j);
+						}
+						acc[j] = ar.add(acc[j], ar.mul(a, B.values[kb]));
+					}
+				}
+				std::sort(touched.begin(), touched.end());
+				size_t nnz = 0;
+				for (size_t j : touched)
+				{
+					if (acc[j] == T()) continue;
+					p.col_index.push_back(j);
+					p.values.push_back(acc[j]);
+					nnz++;
+				}
+				p.row_nnz.push_back(nnz);
+			}
+		});
+
+		csr_matrix<T> res(A.xsize(), B.ysize());
+		size_t total = 0;
+		for (const part& p : parts) total += p.values.size();
+		res.col_index.reserve(total);
+		res.values.reserve(total);
+		for (size_t c = 0; c < chunks; c++)
+		{
+			part& p = parts[c];
+			for (size_t r = 0; r < p.row_nnz.size(); r++)
+			{
+				size_t i = first_row[c] + r;
+				res.row_ptr[i + 1] = res.row_ptr[i] + p.row_nnz[r];
+			}
+			res.col_index.insert(res.col_index.end(), p.col_index.begin(), p.col_index.end());
+			res.values.insert(res.values.end(), std::make_move_iterator(p.values.begin()), std::make_move_iterator(p.values.end()));
+		}
+		return res;
+	}
+
+	/*
+	sparse-sparse product. Returns empty 1x1 matrix if sizes do not match, as matrix<T> does
+	*/
+	template<typename T>
+	csr_matrix<T> operator*(const csr_matrix<T>& A, const csr_matrix<T>& B)
+	{
+		if (A.ysize() != B.xsize()) return csr_matrix<T>(1, 1);
+		return _spgemm(A, B, plain_arithmetic<T>(), sparse_default_threads());
+	}
+
+	template<typename T>
+	csr_matrix<T> mult(const csr_matrix<T>& A, const csr_matrix<T>& B, T mod)
+	{
+		if (A.ysize() != B.xsize()) return csr_matrix<T>(1, 1);
+		return _spgemm(A, B, mod_arithmetic<T>{ mod }, sparse_default_threads());
+	}
+
+	/*
+	sparse-dense product, row i of result is combination of rows of M selected by row i of A
+	*/
+	template<typename T>
+	matrix<T> operator*(const csr_matrix<T>& A, const matrix<T>& M)
+	{
+		if (A.ysize() != M.xsize()) return matrix<T>(1, 1);
+		matrix<T> res(A.xsize(), M.ysize());
+		for (size_t i = 0; i < A.xsize(); i++)
+		{
+			std::vector<T>& row = res.vec[i];
+			for (size_t k = A.row_ptr[i]; k < A.row_ptr[i + 1]; k++)
+			{
+				const T& a = A.values[k];
+				const std::vector<T>& other = M.vec[A.col_index[k]];
+				for (size_t j = 0; j < row.size(); j++)
+				{
+					row[j] += a * other[j];
+				}
+			}
+		}
+		return res;
+	}
+
+	template<typename T>
+	csr_matrix<T> _sparse_identity(size_t size)
+	{
+		csr_matrix<T> res(size, size);
+		res.col_index.resize(size);
+		res.values.assign(size, T(1));
+		for (size_t i = 0; i < size; i++)
+		{
+			res.col_index[i] = i;
+			res.row_ptr[i + 1] = i + 1;
+		}
+		return res;
+	}
+
+	template<typename T, typename Arithmetic>
+	csr_matrix<T> _sparse_pow(const csr_matrix<T>& M, long long power, const Arithmetic& ar)
+	{
+		if (power <= 0) return _sparse_identity<T>(M.xsize());
+		const size_t threads = sparse_default_threads();
+		csr_matrix<T> base = M;
+		while ((power & 1) == 0)
+		{
+			base = _spgemm(base, base, ar, threads);
+			power >>= 1;
+		}
+		csr_matrix<T> res = base;
+		power >>= 1;
+		while (power > 0)
+		{
+			base = _spgemm(base, base, ar, threads);
+			if (power & 1) res = _spgemm(res, base, ar, threads);
+			power >>= 1;
+		}
+		return res;
+	}
+
+	/*
+	binary exponentiation with sparse products. Note that powers of sparse matrix fill in quickly,
+	if only M^power * v is needed use apply_pow, which does not square the matrix for small powers
+	*/
+	template<typename T>
+	csr_matrix<T> pow(const csr_matrix<T>& M, long long power)
+	{
+		if (M.xsize() != M.ysize()) return csr_matrix<T>(1, 1);
+		return _sparse_pow(M, power, plain_arithmetic<T>());
+	}
+
+	template<typename T>
+	csr_matrix<T> pow(const csr_matrix<T>& M, long long power, T mod)
+	{
+		if (M.xsize() != M.ysize()) return csr_matrix<T>(1, 1);
+		return _sparse_pow(M, power, mod_arithmetic<T>{ mod });
+	}
+
+	template<typename T, typename Arithmetic>
+	std::vector<T> _sparse_apply_pow(const csr_matrix<T>& M, long long power, std::vector<T> v, const Arithmetic& ar)
+	{
+		if (M.xsize() != M.ysize() || M.ysize() != v.size()) return std::vector<T>();
+		const size_t threads = sparse_default_threads();
+		std::vector<T> tmp(v.size());
+		// while power is small compared to matrix size repeated products are cheaper than fill-in caused by squaring
+		if (power > 0 && (unsigned long long)power <= M.xsize())
+		{
+			for (long long step = 0; step < power; step++)
+			{
+				_spmv_into(M, v, tmp, ar, threads);
+				v.swap(tmp);
+			}
+			return v;
+		}
+		csr_matrix<T> base = M;
+		while (power > 0)
+		{
+			if (power & 1)
+			{
+				_spmv_into(base, v, tmp, ar, threads);
+				v.swap(tmp);
+			}
+			power >>= 1;
+			if (power > 0) base = _spgemm(base, base, ar, threads);
+		}
+		return v;
+	}
+
+	/*
+	computes M^power * v. Returns empty vector if sizes do not match
+	*/
+	template<typename T>
+	std::vector<T> apply_pow(const csr_matrix<T>& M, long long power, std::vector<T> v)
+	{
+		return _sparse_apply_pow(M, power, std::move(v), plain_arithmetic<T>());
+	}
+
+	template<typename T>
+	std::vector<T> apply_pow(const csr_matrix<T>& M, long long power, std::vector<T> v, T mod)
+	{
+		return _sparse_apply_pow(M, power, std::move(v), mod_arithmetic<T>{ mod });
+	}
+
+	template<typename T>
+	std::ostream& operator<<(std::ostream& os, const csr_matrix<T>& M)
+	{
+		for (size_t i = 0; i < M.xsize(); i++)
+		{
+			for (size_t k = M.row_ptr[i]; k < M.row_ptr[i + 1]; k++)
+			{
+				os << "(" << i << ", " << M.col_index[k] << "): " << M.values[k] << "\n";
+			}
+		}
+		return os;
+	}
+}
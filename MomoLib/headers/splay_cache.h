@@ -0,0 +1,279 @@
+#pragma once
+
+#include <functional>
+#include <limits>
+#include <utility>
+
+#include "splay_tree.h"
+
+namespace momo
+{
+	// default size of cache entry: memory of key and value themselves, without memory they own
+	template<typename K, typename V>
+	struct splay_cache_sizeof
+	{
+		inline size_t operator()(const K&, const V&) const
+		{
+			return sizeof(K) + sizeof(V);
+		}
+	};
+
+	struct splay_cache_stats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t loads = 0; // misses which were filled by loader
+		size_t evictions = 0;
+
+		inline double hit_rate() const
+		{
+			return hits + misses == 0 ? 0.0 : double(hits) / double(hits + misses);
+		}
+	};
+
+	/*
+	bounded key-value cache on splay_tree (see splay_tree.h). Every lookup splays the key to the root of the tree,
+	so keys which are used often stay near the root and are found in a few steps. Entries are also linked into
+	recency list and least recently used entries are evicted when amount of entries exceeds [max_count] or total size
+	(sum of Sizer()(key, value)) exceeds [max_size]. Entry which was just inserted is never evicted, so one entry bigger
+	than [max_size] is kept alone. On miss get() calls loader(key, value), if it returns true, value is inserted.
+	Pointers returned by get() and put() are valid until the next call which can evict entries
+	*/
+	template<typename K, typename V, typename Compare = std::less<K>, typename Sizer = splay_cache_sizeof<K, V>, template<typename> class Alloc = pool_allocator>
+	class splay_cache
+	{
+	public:
+		using key_type = K;
+		using mapped_type = V;
+		using loader_type = std::function<bool(const K&, V&)>;
+	private:
+		struct entry
+		{
+			K key;
+			V value;
+			size_t size = 0;
+			entry* newer = nullptr;
+			entry* older = nullptr;
+
+			template<typename U>
+			entry(const K& key, U&& value)
+				: key(key), value(std::forward<U>(value)) { }
+		};
+
+		struct entry_compare
+		{
+			using is_transparent = void;
+
+			Compare comp;
+
+			inline bool operator()(const entry& left, const entry& right) const
+			{
+				return comp(left.key, right.key);
+			}
+
+			inline bool operator()(const entry& left, const K& right) const
+			{
+				return comp(left.key, right);
+			}
+
+			inline bool operator()(const K& left, const entry& right) const
+			{
+				return comp(left, right.key);
+			}
+		};
+
+		using tree_type = splay_tree<entry, entry_compare, Alloc>;
+
+		tree_type _tree;
+		entry* _newest = nullptr;
+		entry* _oldest = nullptr;
+		size_t _total_size = 0;
+		size_t _max_count;
+		size_t _max_size;
+		Sizer _sizer;
+		loader_type _loader;
+		splay_cache_stats _stats;
+
+		inline void _unlink(entry* e)
+		{
+			if (e->newer != nullptr) e->newer->older = e->older;
+			else _newest = e->older;
+			if (e->older != nullptr) e->older->newer = e->newer;
+			else _oldest = e->newer;
+			e->newer = e->older = nullptr;
+		}
+
+		inline void _push_newest(entry* e)
+		{
+			e->older = _newest;
+			if (_newest != nullptr) _newest->newer = e;
+			else _oldest = e;
+			_newest = e;
+		}
+
+		inline void _touch(entry* e)
+		{
+			if (e == _newest) return;
+			_unlink(e);
+			_push_newest(e);
+		}
+
+		// evicts the oldest entries until limits are satisfied, the newest entry is always kept
+		void _evict()
+		{
+			while (_oldest != _newest && (_tree.size() > _max_count || _total_size > _max_size))
+			{
+				entry* e = _oldest;
+				_unlink(e);
+				_total_size -= e->size;
+				_tree.erase(*e);
+				_stats.evictions++;
+			}
+		}
+
+		template<typename U>
+		entry* _put(const K& key, U&& value)
+		{
+			entry* e = _tree.find(key);
+			if (e == nullptr)
+			{
+				e = _tree.try_emplace(key, key, std::forward<U>(value)).first;
+				_push_newest(e);
+			}
+			else
+			{
+				e->value = std::forward<U>(value);
+				_total_size -= e->size;
+				_touch(e);
+			}
+			e->size = _sizer(e->key, e->value);
+			_total_size += e->size;
+			_evict();
+			return e;
+		}
+	public:
+		// [max_count] limits amount of entries, [max_size] limits total size of entries
+		inline explicit splay_cache(size_t max_count, size_t max_size = std::numeric_limits<size_t>::max(),
+			loader_type loader = loader_type(), const Sizer& sizer = Sizer(), const Compare& comp = Compare())
+			: _tree(entry_compare{ comp }), _max_count(max_count), _max_size(max_size), _sizer(sizer), _loader(std::move(loader)) { }
+
+		// entries point to each other, so cache is not copied or moved
+		splay_cache(const splay_cache&) = delete;
+		splay_cache& operator=(const splay_cache&) = delete;
+
+		/*
+		returns value of [key] and marks it as the most recently used. On miss value is loaded with loader,
+		returns nullptr if there is no loader or it has failed
+		*/
+		V* get(const K& key)
+		{
+			entry* e = _tree.find(key);
+			if (e != nullptr)
+			{
+				_stats.hits++;
+				_touch(e);
+				return &e->value;
+			}
+			_stats.misses++;
+			if (!_loader) return nullptr;
+			V value = V();
+			if (!_loader(key, value)) return nullptr;
+			_stats.loads++;
+			return &_put(key, std::move(value))->value;
+		}
+
+		// inserts or replaces value of [key], it becomes the most recently used one
+		inline V* put(const K& key, const V& value)
+		{
+			return &_put(key, value)->value;
+		}
+
+		inline V* put(const K& key, V&& value)
+		{
+			return &_put(key, std::move(value))->value;
+		}
+
+		// checks if [key] is cached without changing statistics and recency of entries
+		inline bool contains(const K& key)
+		{
+			return _tree.contains(key);
+		}
+
+		inline bool erase(const K& key)
+		{
+			entry* e = _tree.find(key);
+			if (e == nullptr) return false;
+			_unlink(e);
+			_total_size -= e->size;
+			_tree.erase(key);
+			return true;
+		}
+
+		inline void clear()
+		{
+			_tree.clear();
+			_newest = _oldest = nullptr;
+			_total_size = 0;
+		}
+
+		// changes limits, entries which do not fit are evicted immediately
+		inline void set_limits(size_t max_count, size_t max_size = std::numeric_limits<size_t>::max())
+		{
+			_max_count = max_count;
+			_max_size = max_size;
+			_evict();
+		}
+
+		inline void set_loader(loader_type loader)
+		{
+			_loader = std::move(loader);
+		}
+
+		// amount of entries
+		inline size_t size() const
+		{
+			return _tree.size();
+		}
+
+		inline bool empty() const
+		{
+			return _tree.empty();
+		}
+
+		// sum of sizes of all entries
+		inline size_t total_size() const
+		{
+			return _total_size;
+		}
+
+		inline size_t max_count() const
+		{
+			return _max_count;
+		}
+
+		inline size_t max_size() const
+		{
+			return _max_size;
+		}
+
+		inline const splay_cache_stats& stats() const
+		{
+			return _stats;
+		}
+
+		inline void reset_stats()
+		{
+			_stats = splay_cache_stats();
+		}
+
+		// calls func(key, value) for every entry from the most recently used to the least recently used
+		template<typename Func>
+		inline void apply_visitor(Func&& func) const
+		{
+			for (const entry* e = _newest; e != nullptr; e = e->older)
+			{
+				func(e->key, e->value);
+			}
+		}
+	};
+}
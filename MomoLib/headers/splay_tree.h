@@ -1,246 +1,736 @@
 #pragma once
 
-#include <iostream>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-/*
-this file contains splay tree implementation.
-I would not recommend to use it in your code, as it was not properly tested
-also, it is not STL compatible at all. Probably, I would rewrite is some day
-*/
+#include "pool_allocator.h"
+#include "treap.h"
 
-template<typename T>
-struct node
+namespace momo
 {
-	T value;
-	node<T> *left, *right, *parent;
-
-	node(T value, node<T>* parent) : value(value), parent(parent)
+	/*
+	ordered set of unique values on top-down splay tree. Every access moves the found node to the root in one pass
+	from the root down (no recursion and no parent pointers), so recently used values are found in a few steps and
+	all operations are O(log n) amortized. Nodes store size of their subtree for order statistics (nth, order_of_key)
+	and summary of [Summary] policy (see treap_no_summary in treap.h, range updates are not supported) for range
+	queries. Nodes are taken from pool_allocator by default. Lookups change shape of the tree, so they are not const
+	and tree must not be used by several threads at once even for reading.
+	Values are returned by pointer and can be modified, as long as their order does not change
+	*/
+	template<typename T, typename Compare = std::less<T>, template<typename> class Alloc = pool_allocator, typename Summary = treap_no_summary<T> >
+	class splay_tree
 	{
-		left = right = nullptr;
-	}
-};
+	public:
+		using value_type = T;
+		using key_compare = Compare;
+		using summary_type = typename Summary::summary_type;
+		using splay_tree_pair = std::pair<splay_tree, splay_tree>;
+	private:
+		struct Node : treap_summary_storage<Summary>
+		{
+			T value;
+			size_t sub_tree_size = 1;
+			Node* left = nullptr;
+			Node* right = nullptr;
 
-template<typename T>
-class splayTree
-{
-	node<T>* root;
+			template<typename... Args>
+			explicit Node(std::in_place_t, Args&&... args)
+				: value(std::forward<Args>(args)...)
+			{
+				_update();
+			}
 
-	bool isRoot(node<T>* p)
-	{
-		return p->parent == nullptr;
-	}
+			inline void _update()
+			{
+				sub_tree_size = 1 + _size(left) + _size(right);
+				if constexpr (!std::is_empty<summary_type>::value)
+				{
+					auto summary = Summary::summarize(value);
+					if (left != nullptr) summary = Summary::combine(left->summary, summary);
+					if (right != nullptr) summary = Summary::combine(summary, right->summary);
+					this->summary = summary;
+				}
+			}
+		};
 
-	void clear(node<T>* p)
-	{
-		if (p == nullptr) return;
-		clear(p->left);
-		clear(p->right);
-		delete p;
-	}
+		using node_ptr = Node*;
+		using node_ptr_pair = std::pair<node_ptr, node_ptr>;
+	public:
+		using allocator = Alloc<Node>;
+	private:
+		using allocator_traits = std::allocator_traits<allocator>;
 
-	void setParent(node<T>* p, node<T>* parent)
-	{
-		if (p != nullptr) p->parent = parent;
-	}
+		node_ptr _root = nullptr;
+		Compare _comp;
+		allocator _alloc;
 
-	void updateParent(node<T>* p)
-	{
-		setParent(p->left, p);
-		setParent(p->right, p);
-	}
+		static inline size_t _size(node_ptr node)
+		{
+			return node == nullptr ? 0 : node->sub_tree_size;
+		}
 
-	void rotate(node<T>* parent, node<T>* p)
-	{
-		node<T>* prep = parent->parent;
-		if (prep != nullptr)
+		template<typename... Args>
+		inline node_ptr _construct_node(Args&&... args)
 		{
-			if (prep->left == parent) prep->left = p;
-			else prep->right = p;
+			node_ptr node = allocator_traits::allocate(_alloc, 1);
+			allocator_traits::construct(_alloc, node, std::in_place, std::forward<Args>(args)...);
+			return node;
 		}
-		if (parent->left == p)
+
+		inline void _destroy_node(node_ptr node) noexcept
 		{
-			parent->left = p->right;
-			p->right = parent;
+			allocator_traits::destroy(_alloc, node);
+			allocator_traits::deallocate(_alloc, node, 1);
 		}
-		else
+
+		// frees whole tree, pool of trivially destructible nodes is released at once if it is not shared
+		void _release_tree(node_ptr root) noexcept
 		{
-			parent->right = p->left;
-			p->left = parent;
+			if constexpr (treap_is_pool_allocator<allocator>::value && std::is_trivially_destructible<Node>::value)
+			{
+				if (_alloc.unique())
+				{
+					_alloc.release();
+					return;
+				}
+			}
+			_destroy_tree(root);
 		}
-		updateParent(p);
-		updateParent(parent);
-		p->parent = prep;
-		if (isRoot(p)) root = p;
-	}
 
-	node<T>* splay(node<T>* p)
-	{
-		if (isRoot(p)) return p;
-		node<T>* parent = p->parent;
-		node<T>* prep = parent->parent;
-		if (isRoot(parent))
+		// frees subtree without recursion, see treap_core::destroy_tree
+		void _destroy_tree(node_ptr node) noexcept
 		{
-			rotate(parent, p);
-			return p;
+			treap_core<Node>::destroy_tree(node, [this](node_ptr p) { _destroy_node(p); });
 		}
-		bool zigzig = (prep->left == parent) == (parent->left == p);
-		if (zigzig)
+
+		// copies value, size and summary of every node, children are linked by treap_core::deep_copy
+		node_ptr _deep_copy(const node_ptr from)
 		{
-			rotate(prep, parent);
-			rotate(parent, p);
+			return treap_core<Node>::deep_copy(from, [this](node_ptr source, node_ptr)
+			{
+				node_ptr node = _construct_node(source->value);
+				node->sub_tree_size = source->sub_tree_size;
+				if constexpr (!std::is_empty<summary_type>::value)
+				{
+					node->summary = source->summary;
+				}
+				return node;
+			});
 		}
-		else
+
+		/*
+		top-down splay. [direction](node) tells where the target is: < 0 in the left subtree, > 0 in the right one, 0 in
+		the node itself, it is called once for every node of the search path from the root down. Nodes smaller than the
+		target are collected into the left tree, bigger ones into the right tree. Right spine of the left tree (and left
+		spine of the right tree) is kept reversed while going down, so after the last node is reached the spines are
+		walked back bottom-up, relinked and updated without a stack. Returns the new root: the target or the last node
+		of the path if there is no target
+		*/
+		template<typename Direction>
+		static node_ptr _splay(node_ptr root, Direction&& direction)
 		{
-			rotate(parent, p);
-			rotate(prep, p);
+			node_ptr left_spine = nullptr;  // last node of the left tree, linked to previous ones by right pointers
+			node_ptr right_spine = nullptr; // last node of the right tree, linked to previous ones by left pointers
+			node_ptr current = root;
+			int dir = direction(current);
+			while (dir != 0)
+			{
+				if (dir < 0)
+				{
+					node_ptr child = current->left;
+					if (child == nullptr) break;
+					int child_dir = direction(child);
+					if (child_dir < 0)
+					{
+						// zig-zig: rotate right before going down
+						current->left = child->right;
+						child->right = current;
+						current->_update();
+						current = child;
+						child = current->left;
+						if (child == nullptr) break;
+						child_dir = direction(child);
+					}
+					current->left = right_spine;
+					right_spine = current;
+					current = child;
+					dir = child_dir;
+				}
+				else
+				{
+					node_ptr child = current->right;
+					if (child == nullptr) break;
+					int child_dir = direction(child);
+					if (child_dir > 0)
+					{
+						// zag-zag: rotate left before going down
+						current->right = child->left;
+						child->left = current;
+						current->_update();
+						current = child;
+						child = current->right;
+						if (child == nullptr) break;
+						child_dir = direction(child);
+					}
+					current->right = left_spine;
+					left_spine = current;
+					current = child;
+					dir = child_dir;
+				}
+			}
+			while (left_spine != nullptr)
+			{
+				node_ptr next = left_spine->right;
+				left_spine->right = current->left;
+				left_spine->_update();
+				current->left = left_spine;
+				left_spine = next;
+			}
+			while (right_spine != nullptr)
+			{
+				node_ptr next = right_spine->left;
+				right_spine->left = current->right;
+				right_spine->_update();
+				current->right = right_spine;
+				right_spine = next;
+			}
+			current->_update();
+			return current;
 		}
-		return splay(p);
-	}
 
-public:
-	splayTree() : root(nullptr) {}
+		// splays [key] or its neighbour to the root
+		template<typename Key>
+		inline node_ptr _splay_key(node_ptr root, const Key& key) const
+		{
+			return _splay(root, [this, &key](node_ptr node)
+			{
+				if (_comp(key, node->value)) return -1;
+				if (_comp(node->value, key)) return 1;
+				return 0;
+			});
+		}
 
-	T insert(T value)
-	{
-		std::pair<splayTree<T>, splayTree<T> > trees;
-		split(trees, value);
-		node<T>* p = new node<T>(value, nullptr);
-		root = p;
-		root->left = trees.first.root;
-		root->right = trees.second.root;
-		updateParent(root);
-		trees.first.root = trees.second.root = nullptr;
-		return value;
-	}
-
-	bool find(T value)
-	{
-		if (root == nullptr) return false;
-		node<T>* p = root;
-		while (true)
+		// splays the first value which is not less than [key] or its predecessor to the root
+		template<typename Key>
+		inline node_ptr _splay_lower(node_ptr root, const Key& key) const
+		{
+			return _splay(root, [this, &key](node_ptr node)
+			{
+				return _comp(node->value, key) ? 1 : -1;
+			});
+		}
+
+		// splays the first value which is greater than [key] or its predecessor to the root
+		template<typename Key>
+		inline node_ptr _splay_upper(node_ptr root, const Key& key) const
+		{
+			return _splay(root, [this, &key](node_ptr node)
+			{
+				return _comp(key, node->value) ? -1 : 1;
+			});
+		}
+
+		// splays value with index [k] to the root
+		static inline node_ptr _splay_nth(node_ptr root, size_t k)
 		{
-			if (p->value == value)
+			return _splay(root, [&k](node_ptr node)
 			{
-				splay(p);
-				return true;
+				size_t left = _size(node->left);
+				if (k < left) return -1;
+				if (k == left) return 0;
+				k -= left + 1;
+				return 1;
+			});
+		}
+
+		static inline node_ptr _splay_min(node_ptr root)
+		{
+			return _splay(root, [](node_ptr) { return -1; });
+		}
+
+		static inline node_ptr _splay_max(node_ptr root)
+		{
+			return _splay(root, [](node_ptr) { return 1; });
+		}
+
+		// all values of [left] must be less than values of [right]
+		static node_ptr _merge(node_ptr left, node_ptr right)
+		{
+			if (left == nullptr) return right;
+			if (right == nullptr) return left;
+			left = _splay_max(left);
+			left->right = right;
+			left->_update();
+			return left;
+		}
+
+		// splits tree into values which are less than [key] and all others
+		template<typename Key>
+		node_ptr_pair _split(node_ptr root, const Key& key) const
+		{
+			if (root == nullptr) return node_ptr_pair(nullptr, nullptr);
+			root = _splay_lower(root, key);
+			if (_comp(root->value, key))
+			{
+				node_ptr right = root->right;
+				root->right = nullptr;
+				root->_update();
+				return node_ptr_pair(root, right);
 			}
-			if (p->value > value)
+			else
 			{
-				if (p->left != nullptr) p = p->left;
-				else
-				{
-					splay(p);
-					return false;
-				}
+				node_ptr left = root->left;
+				root->left = nullptr;
+				root->_update();
+				return node_ptr_pair(left, root);
+			}
+		}
+
+		// splits tree into values which are not greater than [key] and all others
+		template<typename Key>
+		node_ptr_pair _split_upper(node_ptr root, const Key& key) const
+		{
+			if (root == nullptr) return node_ptr_pair(nullptr, nullptr);
+			root = _splay_upper(root, key);
+			if (_comp(key, root->value))
+			{
+				node_ptr left = root->left;
+				root->left = nullptr;
+				root->_update();
+				return node_ptr_pair(left, root);
 			}
 			else
 			{
-				if (p->right != nullptr) p = p->right;
-				else
+				node_ptr right = root->right;
+				root->right = nullptr;
+				root->_update();
+				return node_ptr_pair(root, right);
+			}
+		}
+
+		template<typename Key>
+		inline value_type* _find(const Key& key)
+		{
+			if (_root == nullptr) return nullptr;
+			_root = _splay_key(_root, key);
+			if (_comp(key, _root->value) || _comp(_root->value, key)) return nullptr;
+			return &_root->value;
+		}
+
+		// successor of the root is splayed to the root of its right subtree, so it is still close to the top
+		inline value_type* _root_successor()
+		{
+			if (_root->right == nullptr) return nullptr;
+			_root->right = _splay_min(_root->right);
+			return &_root->right->value;
+		}
+
+		template<typename Key>
+		inline value_type* _lower_bound(const Key& key)
+		{
+			if (_root == nullptr) return nullptr;
+			_root = _splay_lower(_root, key);
+			if (!_comp(_root->value, key)) return &_root->value;
+			return _root_successor();
+		}
+
+		template<typename Key>
+		inline value_type* _upper_bound(const Key& key)
+		{
+			if (_root == nullptr) return nullptr;
+			_root = _splay_upper(_root, key);
+			if (_comp(key, _root->value)) return &_root->value;
+			return _root_successor();
+		}
+
+		template<typename Key>
+		inline bool _erase(const Key& key)
+		{
+			if (_find(key) == nullptr) return false;
+			node_ptr root = _root;
+			_root = _merge(root->left, root->right);
+			_destroy_node(root);
+			return true;
+		}
+
+		template<typename Key>
+		inline size_t _order_of_key(const Key& key)
+		{
+			if (_root == nullptr) return 0;
+			_root = _splay_lower(_root, key);
+			return _size(_root->left) + (_comp(_root->value, key) ? 1 : 0);
+		}
+
+		// cuts values of [first; last) out of the tree, they must be merged back with _merge_range
+		inline node_ptr _cut_range(const value_type& first, const value_type& last, node_ptr_pair& rest)
+		{
+			rest = _split(_root, first);
+			node_ptr_pair parts = _split(rest.second, last);
+			rest.second = parts.second;
+			_root = nullptr;
+			return parts.first;
+		}
+
+		inline void _merge_range(node_ptr range, const node_ptr_pair& rest)
+		{
+			_root = _merge(_merge(rest.first, range), rest.second);
+		}
+
+		template<typename Func>
+		static void _apply(node_ptr root, Func&& func)
+		{
+			std::vector<node_ptr> st;
+			node_ptr current = root;
+			while (current != nullptr || !st.empty())
+			{
+				while (current != nullptr)
 				{
-					splay(p);
-					return false;
+					st.push_back(current);
+					current = current->left;
 				}
+				current = st.back();
+				st.pop_back();
+				func(current->value);
+				current = current->right;
 			}
 		}
-	}
+	public:
+		inline splay_tree() = default;
 
-	std::pair<splayTree<T>, splayTree<T> >& split(std::pair<splayTree<T>, splayTree<T> >& out, T value)
-	{
-		find(value);
-		if (root != nullptr)
+		inline explicit splay_tree(const Compare& comp)
+			: _comp(comp) { }
+
+		/*
+		builds tree of sorted unique values in O(n). Values form a left spine with the greatest value in the root,
+		the first accesses balance it (amortized cost stays O(log n) per operation)
+		*/
+		template<typename SortedIt>
+		inline splay_tree(const SortedIt& first, const SortedIt& last, const Compare& comp = Compare())
+			: _comp(comp)
 		{
-			if (root->value == value)
+			for (SortedIt it = first; it != last; ++it)
 			{
-				out.first.root = root->left;
-				out.second.root = root->right;
-				delete root;
+				node_ptr node = _construct_node(*it);
+				node->left = _root;
+				node->_update();
+				_root = node;
 			}
-			else if (root->value > value)
+		}
+
+		inline splay_tree(const splay_tree& tree)
+			: _comp(tree._comp), _alloc(allocator_traits::select_on_container_copy_construction(tree._alloc))
+		{
+			_root = _deep_copy(tree._root);
+		}
+
+		inline splay_tree(splay_tree&& tree) noexcept
+			: _root(tree._root), _comp(std::move(tree._comp)), _alloc(std::move(tree._alloc))
+		{
+			tree._root = nullptr;
+		}
+
+		inline splay_tree& operator=(const splay_tree& tree)
+		{
+			if (this == &tree) return *this;
+			clear();
+			_comp = tree._comp;
+			_root = _deep_copy(tree._root);
+			return *this;
+		}
+
+		inline splay_tree& operator=(splay_tree&& tree) noexcept
+		{
+			if (this == &tree) return *this;
+			clear();
+			_root = tree._root;
+			_comp = std::move(tree._comp);
+			_alloc = std::move(tree._alloc);
+			tree._root = nullptr;
+			return *this;
+		}
+
+		inline ~splay_tree()
+		{
+			if (_root != nullptr) _release_tree(_root);
+		}
+
+		inline size_t size() const noexcept
+		{
+			return _size(_root);
+		}
+
+		inline bool empty() const noexcept
+		{
+			return _root == nullptr;
+		}
+
+		inline void clear() noexcept
+		{
+			if (_root != nullptr)
 			{
-				out.second.root = root;
-				out.first.root = root->left;
-				root->left = nullptr;
+				_release_tree(_root);
+				_root = nullptr;
+			}
+		}
+
+		inline allocator& get_allocator()
+		{
+			return _alloc;
+		}
+
+		inline key_compare key_comp() const
+		{
+			return _comp;
+		}
+
+		/*
+		inserts value constructed from [args] if there is no value equal to [key], [key] must be equal to the value
+		which would be constructed. Node is allocated only if the value is inserted. Returns pointer to the value in
+		the tree and true if it was inserted, or pointer to the equal value and false
+		*/
+		template<typename Key, typename... Args>
+		std::pair<value_type*, bool> try_emplace(const Key& key, Args&&... args)
+		{
+			if (_root == nullptr)
+			{
+				_root = _construct_node(std::forward<Args>(args)...);
+				return { &_root->value, true };
+			}
+			_root = _splay_key(_root, key);
+			// [key] may refer to one of [args], so it is compared before they are moved into the node
+			bool less = _comp(key, _root->value);
+			if (!less && !_comp(_root->value, key)) return { &_root->value, false };
+			node_ptr node = _construct_node(std::forward<Args>(args)...);
+			if (less)
+			{
+				node->left = _root->left;
+				node->right = _root;
+				_root->left = nullptr;
 			}
 			else
 			{
-				out.second.root = root->right;
-				out.first.root = root;
-				root->right = nullptr;
+				node->right = _root->right;
+				node->left = _root;
+				_root->right = nullptr;
 			}
-			setParent(out.first.root, nullptr);
-			setParent(out.second.root, nullptr);
-			root = nullptr;
+			_root->_update();
+			node->_update();
+			_root = node;
+			return { &node->value, true };
 		}
-		return out;
-	}
 
-	void merge(std::pair<splayTree<T>, splayTree<T> >& in)
-	{
-		if (root != nullptr) return; // if tree is not empty do not merge
-		if (in.first.root == nullptr)
+		/*
+		inserts value constructed from [args] if there is no equal value. Returns pointer to the value in the tree
+		and true if it was inserted, or pointer to the equal value and false. Value is constructed in place only if
+		it is passed as is, otherwise it is built on the stack for the lookup and moved into a node on a miss
+		*/
+		template<typename... Args>
+		inline std::pair<value_type*, bool> emplace(Args&&... args)
+		{
+			if constexpr (sizeof...(Args) == 1 && std::conjunction<std::is_same<std::decay_t<Args>, value_type>...>::value)
+			{
+				return try_emplace(args..., std::forward<Args>(args)...);
+			}
+			else
+			{
+				value_type value(std::forward<Args>(args)...);
+				return try_emplace(value, std::move(value));
+			}
+		}
+
+		inline std::pair<value_type*, bool> insert(const value_type& value)
 		{
-			root = in.second.root;
-			in.second.root = nullptr;
-			return;
+			return try_emplace(value, value);
 		}
-		if (in.second.root == nullptr)
+
+		inline std::pair<value_type*, bool> insert(value_type&& value)
 		{
-			root = in.first.root;
-			in.first.root = nullptr;
-			return;
+			return try_emplace(value, std::move(value));
 		}
-		in.second.find(in.first.root->value);
-		root = in.second.root;
-		root->left = in.first.root;
-		in.first.root = nullptr;
-		in.second.root = nullptr;
-	}
 
-	void erase(T value)
-	{
-		if (!find(value)) return;
-		std::pair<splayTree<T>, splayTree<T> > trees;
-		trees.first.root = root->left;
-		trees.second.root = root->right;
-		setParent(root->left, nullptr);
-		setParent(root->right, nullptr);
-		delete root;
-		root = nullptr;
-		merge(trees);
-	}
-
-	~splayTree()
-	{
-		clear(root);
-	}
+		// returns pointer to value equal to [key] or nullptr if there is none
+		inline value_type* find(const value_type& key)
+		{
+			return _find(key);
+		}
+
+		// lookup by any type comparable with values, if Compare is transparent (as std::less<>)
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline value_type* find(const Key& key)
+		{
+			return _find(key);
+		}
 
-	template<typename T1>
-	friend void display(splayTree<T1>&);
+		inline bool contains(const value_type& key)
+		{
+			return _find(key) != nullptr;
+		}
 
-	template<typename T1>
-	friend void printNode(node<T1>*);
-};
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline bool contains(const Key& key)
+		{
+			return _find(key) != nullptr;
+		}
 
-template<typename T>
-void printNode(node<T>* p)
-{
-	std::cout << p->value << " ";
-	if (p->left != nullptr)
-	{
-		std::cout << "[L" << p->value << "]";
-		printNode(p->left);
-	}
-	if (p->right != nullptr)
-	{
-		std::cout << "[R" << p->value << "]";
-		printNode(p->right);
-	}
-}
+		inline size_t count(const value_type& key)
+		{
+			return _find(key) != nullptr ? 1 : 0;
+		}
 
-template<typename T>
-void display(splayTree<T>& tree)
-{
-	if (tree.root != nullptr) printNode(tree.root);
-	std::cout << std::endl;
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline size_t count(const Key& key)
+		{
+			return _find(key) != nullptr ? 1 : 0;
+		}
+
+		// first value which is not less than [key], nullptr if there is none
+		inline value_type* lower_bound(const value_type& key)
+		{
+			return _lower_bound(key);
+		}
+
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline value_type* lower_bound(const Key& key)
+		{
+			return _lower_bound(key);
+		}
+
+		// first value which is greater than [key], nullptr if there is none
+		inline value_type* upper_bound(const value_type& key)
+		{
+			return _upper_bound(key);
+		}
+
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline value_type* upper_bound(const Key& key)
+		{
+			return _upper_bound(key);
+		}
+
+		// erases value equal to [key], returns false if there is none
+		inline bool erase(const value_type& key)
+		{
+			return _erase(key);
+		}
+
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline bool erase(const Key& key)
+		{
+			return _erase(key);
+		}
+
+		// amount of values which are less than [key]
+		inline size_t order_of_key(const value_type& key)
+		{
+			return _order_of_key(key);
+		}
+
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline size_t order_of_key(const Key& key)
+		{
+			return _order_of_key(key);
+		}
+
+		// value with index [k] in sorted order, k must be less than size()
+		inline value_type& nth(size_t k)
+		{
+			_root = _splay_nth(_root, k);
+			return _root->value;
+		}
+
+		// tree must not be empty
+		inline value_type& front()
+		{
+			_root = _splay_min(_root);
+			return _root->value;
+		}
+
+		// tree must not be empty
+		inline value_type& back()
+		{
+			_root = _splay_max(_root);
+			return _root->value;
+		}
+
+		// amount of values in [first; last)
+		inline size_t count_range(const value_type& first, const value_type& last)
+		{
+			node_ptr_pair rest;
+			node_ptr range = _cut_range(first, last, rest);
+			size_t res = _size(range);
+			_merge_range(range, rest);
+			return res;
+		}
+
+		// erases all values in [first; last), returns amount of erased values
+		inline size_t erase_range(const value_type& first, const value_type& last)
+		{
+			node_ptr_pair rest;
+			node_ptr range = _cut_range(first, last, rest);
+			size_t res = _size(range);
+			_merge_range(nullptr, rest);
+			_destroy_tree(range);
+			return res;
+		}
+
+		// summary of all values, tree must not be empty
+		inline const summary_type& summary() const
+		{
+			return _root->summary;
+		}
+
+		// summary of values in [first; last), summary_type() if there are no such values
+		inline summary_type query(const value_type& first, const value_type& last)
+		{
+			node_ptr_pair rest;
+			node_ptr range = _cut_range(first, last, rest);
+			summary_type res = range == nullptr ? summary_type() : range->summary;
+			_merge_range(range, rest);
+			return res;
+		}
+
+		// calls func(value) for every value in sorted order, shape of the tree is not changed
+		template<typename Func>
+		inline void apply_visitor(Func&& func) const
+		{
+			_apply(_root, std::forward<Func>(func));
+		}
+
+		// moves values which are not greater than [value] to the first tree and others to the second one, as treap::split
+		inline splay_tree_pair split(const value_type& value)
+		{
+			splay_tree_pair p{ splay_tree(_comp), splay_tree(_comp) };
+			node_ptr_pair roots = _split_upper(_root, value);
+			p.first._root = roots.first;
+			p.second._root = roots.second;
+			p.first._alloc = _alloc;
+			p.second._alloc = _alloc;
+			_root = nullptr;
+			return p; // NRVO
+		}
+
+		// replaces values with values of both trees, all values of the first tree must be less than values of the second
+		inline void merge(splay_tree_pair& trees)
+		{
+			if (_root != nullptr) _release_tree(_root);
+
+			_root = _merge(trees.first._root, trees.second._root);
+			if (trees.first._root != nullptr)
+			{
+				_alloc = std::move(trees.first._alloc);
+				if constexpr (treap_is_pool_allocator<allocator>::value)
+				{
+					if (trees.second._root != nullptr) _alloc.adopt(trees.second._alloc);
+				}
+			}
+			else
+			{
+				_alloc = std::move(trees.second._alloc);
+			}
+			trees.first._root = trees.second._root = nullptr;
+		}
+	};
 }
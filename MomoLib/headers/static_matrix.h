@@ -0,0 +1,307 @@
+#pragma once
+
+#include <array>
+#include <utility>
+#include <initializer_list>
+#include <iostream>
+
+#include "matrix.h"
+
+/*
+fixed-size matrix with std::array storage. Sizes are known at compile time, so it lives on the stack,
+never checks dimensions at runtime and all operations are constexpr. Use it for small 2x2, 3x3 and 4x4 transforms,
+matrix<T> is still the right choice when size is known only at runtime
+*/
+namespace momo
+{
+	template<typename T, size_t Rows, size_t Cols = Rows>
+	class static_matrix
+	{
+		static_assert(Rows > 0 && Cols > 0, "static_matrix dimensions must be positive");
+
+		using index_sequence = std::make_index_sequence<Rows * Cols>;
+
+		template<typename Func, size_t... I>
+		static constexpr void _unroll(Func&& func, std::index_sequence<I...>)
+		{
+			(func(I), ...);
+		}
+
+		template<size_t I, size_t J, size_t K, size_t... Ks>
+		static constexpr T _dot(const static_matrix& M1, const static_matrix<T, Cols, K>& M2, std::index_sequence<Ks...>)
+		{
+			return ((M1.data[I * Cols + Ks] * M2.data[Ks * K + J]) + ...);
+		}
+
+		template<size_t K, size_t... I>
+		static constexpr void _mult(const static_matrix& M1, const static_matrix<T, Cols, K>& M2, static_matrix<T, Rows, K>& res, std::index_sequence<I...>)
+		{
+			((res.data[I] = _dot<I / K, I % K, K>(M1, M2, std::make_index_sequence<Cols>())), ...);
+		}
+
+		template<size_t I, size_t... Ks>
+		static constexpr T _dot(const static_matrix& M, const std::array<T, Cols>& v, std::index_sequence<Ks...>)
+		{
+			return ((M.data[I * Cols + Ks] * v[Ks]) + ...);
+		}
+
+		template<size_t... I>
+		static constexpr void _mult(const static_matrix& M, const std::array<T, Cols>& v, std::array<T, Rows>& res, std::index_sequence<I...>)
+		{
+			((res[I] = _dot<I>(M, v, std::make_index_sequence<Cols>())), ...);
+		}
+	public:
+		// row-major storage, element (i, j) is data[i * Cols + j]
+		std::array<T, Rows * Cols> data;
+
+		constexpr static_matrix()
+			: data() { }
+
+		constexpr explicit static_matrix(T fill)
+			: data()
+		{
+			_unroll([this, &fill](size_t i) { data[i] = fill; }, index_sequence());
+		}
+
+		constexpr static_matrix(std::initializer_list<std::initializer_list<T> > src)
+			: data()
+		{
+			size_t i = 0;
+			for (auto row = src.begin(); row != src.end() && i < Rows; row++, i++)
+			{
+				size_t j = 0;
+				for (auto it = row->begin(); it != row->end() && j < Cols; it++, j++)
+				{
+					data[i * Cols + j] = *it;
+				}
+			}
+		}
+
+		explicit static_matrix(const matrix<T>& M)
+			: data()
+		{
+			for (size_t i = 0; i < Rows && i < M.xsize(); i++)
+			{
+				for (size_t j = 0; j < Cols && j < M.ysize(); j++)
+				{
+					data[i * Cols + j] = M.vec[i][j];
+				}
+			}
+		}
+
+		static constexpr static_matrix identity()
+		{
+			static_assert(Rows == Cols, "identity matrix must be square");
+			static_matrix res;
+			for (size_t i = 0; i < Rows; i++)
+			{
+				res.data[i * Cols + i] = T(1);
+			}
+			return res;
+		}
+
+		static constexpr size_t xsize() noexcept
+		{
+			return Rows;
+		}
+
+		static constexpr size_t ysize() noexcept
+		{
+			return Cols;
+		}
+
+		constexpr T& operator()(size_t i, size_t j)
+		{
+			return data[i * Cols + j];
+		}
+
+		constexpr const T& operator()(size_t i, size_t j) const
+		{
+			return data[i * Cols + j];
+		}
+
+		// returns pointer to row, so M[i][j] syntax works as with matrix<T>
+		constexpr T* operator[](size_t i)
+		{
+			return data.data() + i * Cols;
+		}
+
+		constexpr const T* operator[](size_t i) const
+		{
+			return data.data() + i * Cols;
+		}
+
+		matrix<T> to_matrix() const
+		{
+			matrix<T> res(Rows, Cols);
+			for (size_t i = 0; i < Rows; i++)
+			{
+				for (size_t j = 0; j < Cols; j++)
+				{
+					res.vec[i][j] = data[i * Cols + j];
+				}
+			}
+			return res;
+		}
+
+		constexpr static_matrix<T, Cols, Rows> transposed() const
+		{
+			static_matrix<T, Cols, Rows> res;
+			_unroll([this, &res](size_t i) { res.data[(i % Cols) * Rows + i / Cols] = data[i]; }, index_sequence());
+			return res;
+		}
+
+		constexpr bool operator==(const static_matrix& M) const
+		{
+			for (size_t i = 0; i < Rows * Cols; i++)
+			{
+				if (!(data[i] == M.data[i])) return false;
+			}
+			return true;
+		}
+
+		constexpr bool operator!=(const static_matrix& M) const
+		{
+			return !(*this == M);
+		}
+
+		constexpr static_matrix& operator+=(const static_matrix& M)
+		{
+			_unroll([this, &M](size_t i) { data[i] += M.data[i]; }, index_sequence());
+			return *this;
+		}
+
+		constexpr static_matrix& operator-=(const static_matrix& M)
+		{
+			_unroll([this, &M](size_t i) { data[i] -= M.data[i]; }, index_sequence());
+			return *this;
+		}
+
+		constexpr static_matrix& operator*=(const static_matrix& M)
+		{
+			static_assert(Rows == Cols, "operator*= requires square matrix");
+			*this = *this * M;
+			return *this;
+		}
+
+		constexpr static_matrix& operator+=(T value)
+		{
+			_unroll([this, &value](size_t i) { data[i] += value; }, index_sequence());
+			return *this;
+		}
+
+		constexpr static_matrix& operator-=(T value)
+		{
+			_unroll([this, &value](size_t i) { data[i] -= value; }, index_sequence());
+			return *this;
+		}
+
+		constexpr static_matrix& operator*=(T value)
+		{
+			_unroll([this, &value](size_t i) { data[i] *= value; }, index_sequence());
+			return *this;
+		}
+
+		constexpr static_matrix& operator/=(T value)
+		{
+			_unroll([this, &value](size_t i) { data[i] /= value; }, index_sequence()); // no check for devision-by-zero
+			return *this;
+		}
+
+		constexpr static_matrix operator+(const static_matrix& M) const
+		{
+			static_matrix res = *this;
+			return res += M;
+		}
+
+		constexpr static_matrix operator-(const static_matrix& M) const
+		{
+			static_matrix res = *this;
+			return res -= M;
+		}
+
+		constexpr static_matrix operator+(T value) const
+		{
+			static_matrix res = *this;
+			return res += value;
+		}
+
+		constexpr static_matrix operator-(T value) const
+		{
+			static_matrix res = *this;
+			return res -= value;
+		}
+
+		constexpr static_matrix operator*(T value) const
+		{
+			static_matrix res = *this;
+			return res *= value;
+		}
+
+		constexpr static_matrix operator/(T value) const
+		{
+			static_matrix res = *this;
+			return res /= value;
+		}
+
+		/*
+		fully unrolled product: every element of result is a fold over Cols products,
+		so there are no loops left and compiler is free to vectorize independent elements
+		*/
+		template<size_t K>
+		constexpr static_matrix<T, Rows, K> operator*(const static_matrix<T, Cols, K>& M) const
+		{
+			static_matrix<T, Rows, K> res;
+			_mult(*this, M, res, std::make_index_sequence<Rows * K>());
+			return res;
+		}
+
+		constexpr std::array<T, Rows> operator*(const std::array<T, Cols>& v) const
+		{
+			std::array<T, Rows> res{};
+			_mult(*this, v, res, std::make_index_sequence<Rows>());
+			return res;
+		}
+	};
+
+	template<typename T, size_t Rows, size_t Cols>
+	constexpr static_matrix<T, Rows, Cols> operator*(T value, const static_matrix<T, Rows, Cols>& M)
+	{
+		static_matrix<T, Rows, Cols> res = M;
+		for (size_t i = 0; i < Rows * Cols; i++)
+		{
+			res.data[i] = value * M.data[i];
+		}
+		return res;
+	}
+
+	/*
+	iterative binary exponentiation, can be evaluated at compile time
+	*/
+	template<typename T, size_t N>
+	constexpr static_matrix<T, N, N> pow(static_matrix<T, N, N> M, long long power)
+	{
+		static_matrix<T, N, N> res = static_matrix<T, N, N>::identity();
+		while (power > 0)
+		{
+			if (power & 1) res = res * M;
+			power >>= 1;
+			if (power > 0) M = M * M;
+		}
+		return res;
+	}
+
+	template<typename T, size_t Rows, size_t Cols>
+	std::ostream& operator<<(std::ostream& os, const static_matrix<T, Rows, Cols>& M)
+	{
+		for (size_t i = 0; i < Rows; i++)
+		{
+			for (size_t j = 0; j < Cols; j++)
+			{
+				os << M(i, j) << " ";
+			}
+			os << "\n";
+		}
+		return os;
+	}
+}
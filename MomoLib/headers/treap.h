@@ -1,8 +1,17 @@
+#pragma once
+
 #include <vector>
+#include <algorithm>
 #include <cstdint>
 #include <limits>
 #include <functional>
 #include <random>
+#include <type_traits>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <utility>
 
 namespace momo
 {
@@ -28,200 +37,824 @@ namespace momo
 	};
 
 	/*
-	treap iterator. Only provides compare and dereference functions
-	sadly, treap class is not iterable due to it inner structure, so ++/-- are not supported
+	splitmix64 step: adds golden ratio constant to [state] and returns mixed state. Used as a fast generator
+	and as a finalizer of hashes and seeds
 	*/
-	template<typename Treap>
-	class iterator
+	inline uint64_t splitmix64(uint64_t& state)
 	{
-		using pointer_type = typename Treap::treap_node_ptr;
-		using value_type = typename Treap::value_type;
+		uint64_t z = (state += 0x9e3779b97f4a7c15);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+		return z ^ (z >> 31);
+	}
 
-		pointer_type _ptr;
-	public:
-		inline explicit iterator() noexcept
-			: _ptr(nullptr)
+	// unique seed of every thread which uses thread-local generators, seeds differ even for threads created at the same time
+	inline uint64_t random_thread_seed()
+	{
+		static std::atomic<uint64_t> counter{ 0 };
+		uint64_t state = counter.fetch_add(1, std::memory_order_relaxed);
+		return splitmix64(state);
+	}
+
+	/*
+	splitmix64 generator with one 64-bit word of thread-local state. It is much cheaper than random_int64,
+	and threads never share state, so treaps can be built by several threads without locking
+	*/
+	struct random_splitmix64
+	{
+		using RandomReturnType = uint64_t;
+
+		static RandomReturnType get()
 		{
+			thread_local uint64_t state = random_thread_seed();
+			return splitmix64(state);
+		}
+	};
 
+	/*
+	xoshiro256** generator with thread-local state of four words seeded by splitmix64,
+	has better statistical quality than random_splitmix64 at almost the same speed
+	*/
+	struct random_xoshiro256
+	{
+		using RandomReturnType = uint64_t;
+
+		static RandomReturnType get()
+		{
+			thread_local uint64_t s[4] = { 0, 0, 0, 0 };
+			thread_local bool seeded = false;
+			if (!seeded)
+			{
+				uint64_t seed = random_thread_seed();
+				for (uint64_t& word : s) word = splitmix64(seed);
+				seeded = true;
+			}
+			const uint64_t res = _rotl(s[1] * 5, 7) * 9;
+			const uint64_t t = s[1] << 17;
+			s[2] ^= s[0];
+			s[3] ^= s[1];
+			s[1] ^= s[2];
+			s[0] ^= s[3];
+			s[2] ^= t;
+			s[3] = _rotl(s[3], 45);
+			return res;
 		}
 
-		inline explicit iterator(pointer_type p) noexcept
-			: _ptr(p)
+		static inline uint64_t _rotl(uint64_t x, int k)
 		{
+			return (x << k) | (x >> (64 - k));
+		}
+	};
+
+	/*
+	priority derived from hash of the key instead of random number: get(value) mixes [Hash] of value with splitmix64
+	finalizer. Treaps are multisets and equal values with equal priorities would form a chain, so the lowest
+	[tie_bits] bits (the ones kept by 32-bit priorities too) are taken from thread-local random_splitmix64.
+	They decide only between equal values and values whose hashes collide in the other bits, so get() is thread-safe
+	and the shape of a treap depends only on its values up to the order of equal ones. Keys must not be chosen
+	by adversary, otherwise treap can degenerate
+	*/
+	template<typename T, typename Hash = std::hash<T> >
+	struct random_key_hash
+	{
+		using RandomReturnType = uint64_t;
 
+		static constexpr int tie_bits = 16;
+
+		static RandomReturnType get(const T& value)
+		{
+			constexpr uint64_t tie_mask = (uint64_t(1) << tie_bits) - 1;
+			uint64_t state = uint64_t(Hash()(value));
+			return (splitmix64(state) & ~tie_mask) | (random_splitmix64::get() & tie_mask);
 		}
+	};
+
+	template<typename Random, typename T, typename = void>
+	struct treap_has_keyed_random : std::false_type { };
 
-		iterator(const iterator&) = default;
-		iterator(iterator&&) = default;
-		iterator& operator=(const iterator&) = default;
-		iterator& operator=(iterator&&) = default;
+	template<typename Random, typename T>
+	struct treap_has_keyed_random<Random, T, std::void_t<decltype(Random::get(std::declval<const T&>()))> > : std::true_type { };
 
-		inline bool operator==(const iterator& it) const noexcept
+	// priority of a new node with [value]: generators with get(value) receive the value, others are called without arguments
+	template<typename Priority, typename Random, typename T>
+	inline Priority treap_priority(const T& value)
+	{
+		if constexpr (treap_has_keyed_random<Random, T>::value)
 		{
-			return _ptr == it._ptr;
+			return Priority(Random::get(value));
 		}
+		else
+		{
+			return Priority(Random::get());
+		}
+	}
+
+	/*
+	summary policies describe what every treap node stores about its subtree. Policy provides summary_type,
+	summarize(value) for a single node and combine(left, right) for two adjacent ranges (it does not need to be commutative).
+	Policy which also supports lazy range updates provides update_type, apply(value, summary, update, count) which applies
+	update to a node value and to summary of [count] elements, and compose(first, second) which merges two pending updates.
+	If summary depends on order of elements, policy provides reverse(summary) as well
+	*/
+	template<typename T>
+	struct treap_no_summary
+	{
+		struct summary_type { };
 
-		inline bool operator!=(const iterator& it) const noexcept
+		static summary_type summarize(const T&)
 		{
-			return _ptr != it._ptr;
+			return summary_type();
 		}
 
-		inline value_type& operator*() noexcept
+		static summary_type combine(const summary_type&, const summary_type&)
 		{
-			return _ptr->value;
+			return summary_type();
 		}
+	};
+
+	template<typename T>
+	struct treap_sum
+	{
+		using summary_type = T;
 
-		inline const value_type& operator*() const noexcept
+		static summary_type summarize(const T& value)
 		{
-			return _ptr->value;
+			return value;
 		}
 
-		inline const value_type& operator->() const noexcept
+		static summary_type combine(const summary_type& left, const summary_type& right)
 		{
-			return _ptr->value;
+			return left + right;
 		}
+	};
+
+	template<typename T>
+	struct treap_min
+	{
+		using summary_type = T;
 
-		inline value_type& operator->() noexcept
+		static summary_type summarize(const T& value)
 		{
-			return _ptr->value;
+			return value;
+		}
+
+		static summary_type combine(const summary_type& left, const summary_type& right)
+		{
+			return right < left ? right : left;
+		}
+	};
+
+	template<typename T>
+	struct treap_max
+	{
+		using summary_type = T;
+
+		static summary_type summarize(const T& value)
+		{
+			return value;
+		}
+
+		static summary_type combine(const summary_type& left, const summary_type& right)
+		{
+			return left < right ? right : left;
 		}
 	};
 
 	/*
-	treap class. Tried by best to make it more STL-compatible. 
-	Tested on multiple programming contest tasks, so you are free to use it.
+	polynomial hash of the sequence of values (order-dependent), equal ranges have equal hashes.
+	Hash of the reversed sequence is kept too, so reversed ranges of implicit_treap stay correct
 	*/
-	template <typename T, typename Priority = uint64_t, typename Random = random_int64, template<typename> class Alloc = std::allocator>
-	class treap
+	template<typename T, typename Hash = std::hash<T> >
+	struct treap_hash
+	{
+		static constexpr uint64_t base = 0x100000001b3;
+
+		struct summary_type
+		{
+			uint64_t hash = 0;
+			uint64_t reversed_hash = 0; // hash of the same values in reverse order
+			uint64_t power = 1; // base ^ amount of elements
+		};
+
+		static summary_type summarize(const T& value)
+		{
+			uint64_t hash = (uint64_t)Hash()(value) * 0x9e3779b97f4a7c15 + 1;
+			return summary_type{ hash, hash, base };
+		}
+
+		static summary_type combine(const summary_type& left, const summary_type& right)
+		{
+			return summary_type{ left.hash * right.power + right.hash, right.reversed_hash * left.power + left.reversed_hash,
+				left.power * right.power };
+		}
+
+		static void reverse(summary_type& summary)
+		{
+			std::swap(summary.hash, summary.reversed_hash);
+		}
+	};
+
+	/*
+	range add with range sum and range minimum
+	*/
+	template<typename T>
+	struct treap_add_sum_min
+	{
+		struct summary_type
+		{
+			T sum = T();
+			T min = T();
+		};
+		using update_type = T;
+
+		static summary_type summarize(const T& value)
+		{
+			return summary_type{ value, value };
+		}
+
+		static summary_type combine(const summary_type& left, const summary_type& right)
+		{
+			return summary_type{ left.sum + right.sum, right.min < left.min ? right.min : left.min };
+		}
+
+		static void apply(T& value, summary_type& summary, const update_type& add, size_t count)
+		{
+			value += add;
+			summary.sum += add * T(count);
+			summary.min += add;
+		}
+
+		static update_type compose(const update_type& first, const update_type& second)
+		{
+			return first + second;
+		}
+	};
+
+	template<typename Summary, typename = void>
+	struct treap_has_update : std::false_type { };
+
+	template<typename Summary>
+	struct treap_has_update<Summary, std::void_t<typename Summary::update_type> > : std::true_type { };
+
+	template<typename Summary, typename = void>
+	struct treap_has_reverse : std::false_type { };
+
+	template<typename Summary>
+	struct treap_has_reverse<Summary, std::void_t<decltype(Summary::reverse(std::declval<typename Summary::summary_type&>()))> > : std::true_type { };
+
+	/*
+	detects node pool allocators (see pool_allocator.h) which can free all nodes at once in release()
+	and must keep pools of merged trees alive with adopt()
+	*/
+	template<typename Alloc, typename = void>
+	struct treap_is_pool_allocator : std::false_type { };
+
+	template<typename Alloc>
+	struct treap_is_pool_allocator<Alloc, std::void_t<decltype(std::declval<Alloc&>().release()),
+		decltype(std::declval<const Alloc&>().unique()), decltype(std::declval<Alloc&>().adopt(std::declval<const Alloc&>()))> > : std::true_type { };
+
+	/*
+	base of treap node which holds summary. Empty summary is not stored at all (empty base optimization),
+	so treap without summary policy has the same node layout as before
+	*/
+	template<typename Summary, bool Empty = std::is_empty<typename Summary::summary_type>::value>
+	struct treap_summary_storage
+	{
+		typename Summary::summary_type summary;
+	};
+
+	template<typename Summary>
+	struct treap_summary_storage<Summary, true> { };
+
+	// update_type of policy, empty struct for policies without range updates
+	template<typename Summary, typename = void>
+	struct treap_update_type
+	{
+		struct type { };
+	};
+
+	template<typename Summary>
+	struct treap_update_type<Summary, std::void_t<typename Summary::update_type> >
+	{
+		using type = typename Summary::update_type;
+	};
+
+	/*
+	node of treap and treap_map: value, priority, size of subtree and summary of [Summary] policy, linked to children and parent
+	*/
+	template<typename T, typename Priority, typename Summary = treap_no_summary<T> >
+	struct basic_treap_node : treap_summary_storage<Summary>
 	{
-		#define ON_UPDATE(ROOT) \
-		ROOT->_update();\
-		if(_on_update) _on_update(ROOT)
+		T value;
+		Priority priority;
+		size_t sub_tree_size = 1;
+		basic_treap_node* left = nullptr;
+		basic_treap_node* right = nullptr;
+		basic_treap_node* parent = nullptr;
+
+		template<typename... Args>
+		inline basic_treap_node(Priority priority, Args&&... args)
+			: value(std::forward<Args>(args)...), priority(priority)
+		{
+			_update();
+		}
 
-		template<typename U, typename P = int64_t>
-		struct Node
+		// recomputes size and summary from children and links them to this node
+		inline void _update()
 		{
-			U value;
-			P priority;
-			size_t sub_tree_size = 1;
-			Node* left = nullptr;
-			Node* right = nullptr;
+			this->sub_tree_size = 1;
+			if (left != nullptr)
+			{
+				this->sub_tree_size += left->sub_tree_size;
+				left->parent = this;
+			}
+			if (right != nullptr)
+			{
+				this->sub_tree_size += right->sub_tree_size;
+				right->parent = this;
+			}
+			if constexpr (!std::is_empty<typename Summary::summary_type>::value)
+			{
+				auto summary = Summary::summarize(value);
+				if (left != nullptr) summary = Summary::combine(left->summary, summary);
+				if (right != nullptr) summary = Summary::combine(summary, right->summary);
+				this->summary = summary;
+			}
+		}
+	};
 
-			inline Node(const U& value, P priority)
-				: value(value), priority(priority)
+	/*
+	algorithms on binary tree nodes with [left] and [right] pointers, shared by treap, treap_map, implicit_treap and splay_tree.
+	Functions below destroy_tree and deep_copy also need [priority], [sub_tree_size], [parent] and _update() which
+	recomputes node from its children and links them to it. Tree order is given by [goes_left](node) predicate which
+	is true for nodes of the left part and false for the others, nodes of the left part must precede all others
+	*/
+	template<typename Node>
+	struct treap_core
+	{
+		using node_ptr = Node*;
+		using node_ptr_pair = std::pair<node_ptr, node_ptr>;
+
+		/*
+		destroys subtree with destroy(node) without recursion: left child is rotated up until there is none, then node
+		is freed and its right subtree is processed. Every rotation moves one node to the right spine, so it is O(n)
+		*/
+		template<typename Destroy>
+		static void destroy_tree(node_ptr node, Destroy&& destroy) noexcept
+		{
+			while (node != nullptr)
 			{
+				if (node->left != nullptr)
+				{
+					node_ptr left = node->left;
+					node->left = left->right;
+					left->right = node;
+					node = left;
+				}
+				else
+				{
+					node_ptr right = node->right;
+					destroy(node);
+					node = right;
+				}
+			}
+		}
 
+		// copies subtree with copy(source, copied parent) without recursion, children of copies are linked here
+		template<typename Copy>
+		static node_ptr deep_copy(node_ptr from, Copy&& copy)
+		{
+			if (from == nullptr) return nullptr;
+			// pairs of (source node, copied node) whose children are not copied yet
+			std::vector<std::pair<node_ptr, node_ptr> > st;
+			node_ptr root = copy(from, nullptr);
+			st.emplace_back(from, root);
+			while (!st.empty())
+			{
+				auto current = st.back();
+				st.pop_back();
+				node_ptr sources[2] = { current.first->left, current.first->right };
+				node_ptr* children[2] = { &current.second->left, &current.second->right };
+				for (int i = 0; i < 2; i++)
+				{
+					*children[i] = nullptr;
+					if (sources[i] == nullptr) continue;
+					*children[i] = copy(sources[i], current.second);
+					st.emplace_back(sources[i], *children[i]);
+				}
 			}
+			return root;
+		}
 
-			inline Node(U&& value, P priority)
-				: value(std::move(value)), priority(priority)
+		static inline size_t size(node_ptr node) noexcept
+		{
+			return node == nullptr ? 0 : node->sub_tree_size;
+		}
+
+		static inline node_ptr most_left(node_ptr root) noexcept
+		{
+			while (root->left != nullptr) root = root->left;
+			return root;
+		}
+
+		static inline node_ptr most_right(node_ptr root) noexcept
+		{
+			while (root->right != nullptr) root = root->right;
+			return root;
+		}
+
+		// updates nodes pushed to [path] after [base] in reverse order, so children are always updated before parents
+		static inline void update_path(std::vector<node_ptr>& path, size_t base)
+		{
+			while (path.size() > base)
 			{
+				path.back()->_update();
+				path.pop_back();
+			}
+		}
 
+		/*
+		all tree modifications are iterative and top-down: descent links nodes into [hook] slots
+		and remembers them in [path], then sizes and summaries are recomputed bottom-up from the path.
+		Nodes for which [goes_left] is true go to the first tree, others to the second
+		*/
+		template<typename GoesLeft>
+		static node_ptr_pair split(node_ptr root, GoesLeft&& goes_left, std::vector<node_ptr>& path)
+		{
+			const size_t base = path.size();
+			node_ptr tree_left = nullptr, tree_right = nullptr;
+			node_ptr* left_hook = &tree_left;
+			node_ptr* right_hook = &tree_right;
+			while (root != nullptr)
+			{
+				path.push_back(root);
+				if (goes_left(root))
+				{
+					*left_hook = root;
+					left_hook = &root->right;
+					root = root->right;
+				}
+				else
+				{
+					*right_hook = root;
+					right_hook = &root->left;
+					root = root->left;
+				}
 			}
+			*left_hook = nullptr;
+			*right_hook = nullptr;
+			update_path(path, base);
+			if (tree_left != nullptr) tree_left->parent = nullptr;
+			if (tree_right != nullptr) tree_right->parent = nullptr;
+			return { tree_left, tree_right };
+		}
 
-			inline void _update() noexcept
+		// all values of [tree_left] must precede values of [tree_right]
+		static node_ptr merge(node_ptr tree_left, node_ptr tree_right, std::vector<node_ptr>& path)
+		{
+			const size_t base = path.size();
+			node_ptr root = nullptr;
+			node_ptr* hook = &root;
+			while (tree_left != nullptr && tree_right != nullptr)
 			{
-				this->sub_tree_size = 1;
-				if (left != nullptr) this->sub_tree_size += left->sub_tree_size;
-				if (right != nullptr) this->sub_tree_size += right->sub_tree_size;
+				if (tree_left->priority < tree_right->priority)
+				{
+					*hook = tree_left;
+					path.push_back(tree_left);
+					hook = &tree_left->right;
+					tree_left = tree_left->right;
+				}
+				else
+				{
+					*hook = tree_right;
+					path.push_back(tree_right);
+					hook = &tree_right->left;
+					tree_right = tree_right->left;
+				}
 			}
-		};
+			*hook = (tree_left != nullptr) ? tree_left : tree_right;
+			update_path(path, base);
+			if (root != nullptr) root->parent = nullptr;
+			return root;
+		}
+
+		/*
+		inserts [node] below the last ancestor with smaller priority, subtree found there is split by [goes_left]
+		which must place nodes preceding [node] to the left. Returns the new root
+		*/
+		template<typename GoesLeft>
+		static node_ptr insert(node_ptr root, node_ptr node, GoesLeft&& goes_left, std::vector<node_ptr>& path)
+		{
+			const size_t base = path.size();
+			node_ptr* hook = &root;
+			while (*hook != nullptr && (*hook)->priority < node->priority)
+			{
+				node_ptr current = *hook;
+				path.push_back(current);
+				hook = goes_left(current) ? &current->right : &current->left;
+			}
+			node_ptr_pair sub_trees = split(*hook, goes_left, path);
+			node->left = sub_trees.first;
+			node->right = sub_trees.second;
+			node->_update();
+			*hook = node;
+			update_path(path, base);
+			root->parent = nullptr;
+			return root;
+		}
+
+		// the first node for which [goes_left] is false, nullptr if there is none (lower_bound and upper_bound)
+		template<typename GoesLeft>
+		static node_ptr partition_point(node_ptr root, GoesLeft&& goes_left)
+		{
+			node_ptr res = nullptr;
+			while (root != nullptr)
+			{
+				if (goes_left(root))
+				{
+					root = root->right;
+				}
+				else
+				{
+					res = root;
+					root = root->left;
+				}
+			}
+			return res;
+		}
+
+		// amount of nodes for which [goes_left] is true (order_of_key)
+		template<typename GoesLeft>
+		static size_t count_left(node_ptr root, GoesLeft&& goes_left)
+		{
+			size_t order = 0;
+			while (root != nullptr)
+			{
+				if (goes_left(root))
+				{
+					order += 1 + size(root->left);
+					root = root->right;
+				}
+				else
+				{
+					root = root->left;
+				}
+			}
+			return order;
+		}
+
+		// node with [index] in tree order, index must be less than size of the tree
+		static node_ptr nth(node_ptr root, size_t index)
+		{
+			while (true)
+			{
+				size_t left_size = size(root->left);
+				if (index < left_size)
+				{
+					root = root->left;
+				}
+				else if (index == left_size)
+				{
+					return root;
+				}
+				else
+				{
+					index -= left_size + 1;
+					root = root->right;
+				}
+			}
+		}
+	};
+
+	/*
+	bidirectional treap iterator. Nodes keep pointers to their parents, so ++ and -- walk the tree
+	without stack in amortized O(1). Values can not be modified through iterator (as with std::set),
+	because it would break order of the tree. end() is nullptr node, --end() gives the greatest value.
+	Containers whose values are partly mutable (as treap_map) also use it with [Const] = false, such iterator
+	converts to the const one
+	*/
+	template<typename Treap, bool Const = true>
+	class treap_iterator
+	{
+		template<typename T, bool C>
+		friend class treap_iterator;
+
+		using pointer_type = typename Treap::treap_node_ptr;
+		using core = treap_core<typename Treap::treap_node>;
+
+		pointer_type _ptr;
+		const Treap* _tree;
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type = typename Treap::value_type;
+		using difference_type = std::ptrdiff_t;
+		using pointer = typename std::conditional<Const, const value_type*, value_type*>::type;
+		using reference = typename std::conditional<Const, const value_type&, value_type&>::type;
+
+		inline treap_iterator() noexcept
+			: _ptr(nullptr), _tree(nullptr)
+		{
+
+		}
+
+		inline treap_iterator(pointer_type p, const Treap* tree) noexcept
+			: _ptr(p), _tree(tree)
+		{
+
+		}
+
+		// iterator converts to const_iterator
+		template<bool OtherConst, typename = typename std::enable_if<Const && !OtherConst>::type>
+		inline treap_iterator(const treap_iterator<Treap, OtherConst>& it) noexcept
+			: _ptr(it._ptr), _tree(it._tree)
+		{
+
+		}
+
+		inline pointer_type node() const noexcept
+		{
+			return _ptr;
+		}
+
+		inline bool operator==(const treap_iterator& it) const noexcept
+		{
+			return _ptr == it._ptr;
+		}
+
+		inline bool operator!=(const treap_iterator& it) const noexcept
+		{
+			return _ptr != it._ptr;
+		}
+
+		inline reference operator*() const noexcept
+		{
+			return _ptr->value;
+		}
+
+		inline pointer operator->() const noexcept
+		{
+			return &_ptr->value;
+		}
+
+		inline treap_iterator& operator++() noexcept
+		{
+			if (_ptr->right != nullptr)
+			{
+				_ptr = core::most_left(_ptr->right);
+				return *this;
+			}
+			pointer_type child = _ptr;
+			_ptr = _ptr->parent;
+			while (_ptr != nullptr && _ptr->right == child)
+			{
+				child = _ptr;
+				_ptr = _ptr->parent;
+			}
+			return *this;
+		}
+
+		inline treap_iterator& operator--() noexcept
+		{
+			if (_ptr == nullptr)
+			{
+				_ptr = core::most_right(_tree->_root);
+				return *this;
+			}
+			if (_ptr->left != nullptr)
+			{
+				_ptr = core::most_right(_ptr->left);
+				return *this;
+			}
+			pointer_type child = _ptr;
+			_ptr = _ptr->parent;
+			while (_ptr != nullptr && _ptr->left == child)
+			{
+				child = _ptr;
+				_ptr = _ptr->parent;
+			}
+			return *this;
+		}
+
+		inline treap_iterator operator++(int) noexcept
+		{
+			treap_iterator it = *this;
+			++(*this);
+			return it;
+		}
+
+		inline treap_iterator operator--(int) noexcept
+		{
+			treap_iterator it = *this;
+			--(*this);
+			return it;
+		}
+	};
+
+	// set operations and bulk builds with less nodes than this are done in one thread even if more threads are requested
+	constexpr size_t treap_parallel_threshold = 1 << 15;
+
+	inline size_t treap_default_threads()
+	{
+		size_t threads = std::thread::hardware_concurrency();
+		return threads == 0 ? 1 : threads;
+	}
+
+	/*
+	treap class. Tried by best to make it more STL-compatible. 
+	Tested on multiple programming contest tasks, so you are free to use it.
+	[Summary] is a compile-time policy (see treap_no_summary) which defines what every node stores about its subtree,
+	it is recomputed inline on every split / merge step and costs nothing when it is not used
+	*/
+	template <typename T, typename Priority = uint64_t, typename Random = random_int64, template<typename> class Alloc = std::allocator, typename Summary = treap_no_summary<T> >
+	class treap
+	{
 	public:
 		using value_type = T;
-		using treap_node = Node<value_type, Priority>;
+		using treap_node = basic_treap_node<value_type, Priority, Summary>;
 		using treap_node_ptr = treap_node*;
-		using iterator = iterator<treap>;
+		using iterator = treap_iterator<treap>;
+		using const_iterator = iterator;
+		using reverse_iterator = std::reverse_iterator<iterator>;
+		using const_reverse_iterator = reverse_iterator;
 		using treap_node_ptr_pair = typename std::pair<treap_node_ptr, treap_node_ptr>;
 		using treap_pair = typename std::pair<treap, treap>;
 		using allocator = Alloc<treap_node>;
-		using update_callback = std::function<void(treap_node_ptr)>;
+		using allocator_traits = std::allocator_traits<allocator>;
+		using summary_type = typename Summary::summary_type;
+
+		friend iterator;
 
 	private:
+		using core = treap_core<treap_node>;
+
 		inline treap_node_ptr _construct_node(const value_type& value)
 		{
-			treap_node_ptr node = _alloc.allocate(1);
-			Priority priority = Random::get();
-			_alloc.construct(node, value, priority);
-			return node;
+			return _construct_node(value, treap_priority<Priority, Random>(value));
 		}
 
 		inline treap_node_ptr _construct_node(value_type&& value)
 		{
-			treap_node_ptr node = _alloc.allocate(1);
-			Priority priority = Random::get();
-			_alloc.construct(node, std::move(value), priority);
+			Priority priority = treap_priority<Priority, Random>(value);
+			return _construct_node(std::move(value), priority);
+		}
+
+		template<typename U>
+		inline treap_node_ptr _construct_node(U&& value, Priority priority)
+		{
+			treap_node_ptr node = allocator_traits::allocate(_alloc, 1);
+			allocator_traits::construct(_alloc, node, priority, std::forward<U>(value));
 			return node;
 		}
 
 		inline void _destroy_node(treap_node_ptr node) noexcept
 		{
-			_alloc.destroy(node);
-			_alloc.deallocate(node, 1);
+			allocator_traits::destroy(_alloc, node);
+			allocator_traits::deallocate(_alloc, node, 1);
 		}
 
-		void _destroy_node_recursive(treap_node_ptr node) noexcept
+		/*
+		frees whole tree. Nodes of pool allocator which is not shared with other treaps are released
+		block by block without traversal if they do not need destructors
+		*/
+		void _release_tree(treap_node_ptr node) noexcept
 		{
-			if (node->left != nullptr) _destroy_node_recursive(node->left);
-			if (node->right != nullptr) _destroy_node_recursive(node->right);
-			_destroy_node(node);
+			if constexpr (treap_is_pool_allocator<allocator>::value && std::is_trivially_destructible<treap_node>::value)
+			{
+				if (_alloc.unique())
+				{
+					_alloc.release();
+					return;
+				}
+			}
+			_destroy_tree(node);
 		}
 
-		treap_node_ptr _deep_copy_recursive(treap_node_ptr from)
+		// destroys subtree without recursion, see treap_core::destroy_tree
+		inline void _destroy_tree(treap_node_ptr node) noexcept
 		{
-			if (from == nullptr) return nullptr;
-			allocator alloc;
-			treap_node_ptr node = alloc.allocate(1);
-			alloc.construct(node, from->value, from->priority);
-			node->sub_tree_size = from->sub_tree_size;
-			node->left = _deep_copy_recursive(from->left);
-			node->right = _deep_copy_recursive(from->left);
-			return node;
+			core::destroy_tree(node, [this](treap_node_ptr p) { _destroy_node(p); });
 		}
 
-		const treap_node_ptr _most_left(const treap_node_ptr root) const
+		treap_node_ptr _deep_copy(const treap_node_ptr from)
 		{
-			if (root->left != nullptr)
-				return _most_left(root->left);
-			else
-				return root;
+			return core::deep_copy(from, [this](treap_node_ptr source, treap_node_ptr parent)
+			{
+				treap_node_ptr node = allocator_traits::allocate(_alloc, 1);
+				allocator_traits::construct(_alloc, node, *source);
+				node->parent = parent;
+				return node;
+			});
 		}
 
-		const treap_node_ptr _most_right(const treap_node_ptr root) const
+		inline void _update_path(size_t base)
 		{
-			if (root->right != nullptr)
-				return _most_right(root->right);
-			else
-				return root;
+			core::update_path(_path, base);
 		}
 
-		treap_node_ptr _insert_node(treap_node_ptr root, treap_node_ptr node)
+		// equal values go right as in _split, so new value is placed after equal ones and duplicates do not form a chain
+		inline treap_node_ptr _insert_node(treap_node_ptr root, treap_node_ptr node)
 		{
-			if (root == nullptr)
-			{
-				return node;
-			}
-
-			if (root->priority < node->priority)
-			{
-				if (root->value < node->value)
-				{
-					root->right = _insert_node(root->right, node);
-				}
-				else
-				{
-					root->left = _insert_node(root->left, node);
-				}
-				ON_UPDATE(root);
-				return root;
-			}
-			else
-			{
-				treap_node_ptr_pair subTree = _split(root, node->value);
-				node->left = subTree.first;
-				node->right = subTree.second;
-				ON_UPDATE(node);
-				return node;
-			}
+			return core::insert(root, node, [node](treap_node_ptr current) { return !(node->value < current->value); }, _path);
 		}
 
 		void _insert_val(const value_type& value)
@@ -236,117 +869,313 @@ namespace momo
 			_root = _insert_node(_root, node);
 		}
 
-		treap_node_ptr_pair _split(treap_node_ptr root, const value_type& K)
+		inline treap_node_ptr_pair _split(treap_node_ptr root, const value_type& K)
 		{
-			if (root == nullptr)
-				return { nullptr, nullptr };
+			return _split(root, K, false, _path);
+		}
 
-			if (K < root->value)
-			{
-				auto subTree = _split(root->left, K);
-				root->left = subTree.second;
-				ON_UPDATE(root);
-				return { subTree.first, root };
-			}
-			else
+		inline treap_node_ptr _merge(treap_node_ptr tree_left, treap_node_ptr tree_right)
+		{
+			return _merge(tree_left, tree_right, _path);
+		}
+
+		/*
+		values less or equal to K (less than K if [strict]) go to the first tree, others to the second.
+		Nodes are remembered in [path], so trees can be split by different threads with their own paths
+		*/
+		static inline treap_node_ptr_pair _split(treap_node_ptr root, const value_type& K, bool strict, std::vector<treap_node_ptr>& path)
+		{
+			return core::split(root, [&K, strict](treap_node_ptr node) { return strict ? node->value < K : !(K < node->value); }, path);
+		}
+
+		static inline treap_node_ptr _merge(treap_node_ptr tree_left, treap_node_ptr tree_right, std::vector<treap_node_ptr>& path)
+		{
+			return core::merge(tree_left, tree_right, path);
+		}
+
+		/*
+		set operations are join-based: root of one tree splits the other one into values less than, equal to
+		and greater than root value, then left and right parts are processed independently (in parallel if
+		[threads] > 1 and parts are large enough) and joined back under the root or merged if root is dropped.
+		Every thread uses its own scratch path. Nodes are constructed and destroyed by worker threads,
+		so more than one thread is used only with stateless allocators (is_always_equal)
+		*/
+		static std::vector<treap_node_ptr>& _thread_path()
+		{
+			static thread_local std::vector<treap_node_ptr> path;
+			return path;
+		}
+
+		static inline size_t _allowed_threads(size_t threads)
+		{
+			return allocator_traits::is_always_equal::value ? threads : 1;
+		}
+
+		// calls left() and right(), left() is called in a new thread if [parallel]
+		template<typename Left, typename Right>
+		static void _fork(bool parallel, Left&& left, Right&& right)
+		{
+			if (!parallel)
 			{
-				auto subTree = _split(root->right, K);
-				root->right = subTree.first;
-				ON_UPDATE(root);
-				return { root, subTree.second };
+				left();
+				right();
+				return;
 			}
+			std::thread worker(std::forward<Left>(left));
+			right();
+			worker.join();
 		}
 
-		treap_node_ptr _merge(treap_node_ptr tree_left, treap_node_ptr tree_right)
+		static inline bool _fork_parallel(size_t threads, size_t work)
 		{
-			if (tree_left == nullptr) return tree_right;
-			if (tree_right == nullptr) return tree_left;
+			return threads > 1 && work >= treap_parallel_threshold;
+		}
+
+		template<typename Func>
+		void _join_children(treap_node_ptr root, treap_node_ptr& left, treap_node_ptr& right, size_t work, size_t threads, Func&& func)
+		{
+			bool parallel = _fork_parallel(threads, work);
+			size_t left_threads = parallel ? threads / 2 : threads;
+			size_t right_threads = parallel ? threads - threads / 2 : threads;
+			treap_node_ptr left_source = root->left, right_source = root->right;
+			_fork(parallel,
+				[&]() { left = func(left_source, left, left_threads); },
+				[&]() { right = func(right_source, right, right_threads); });
+		}
+
+		// splits [root] into values less than [K], equal to [K] and greater than [K]
+		static void _split_equal(treap_node_ptr root, const value_type& K, treap_node_ptr& less, treap_node_ptr& equal, treap_node_ptr& greater)
+		{
+			std::vector<treap_node_ptr>& path = _thread_path();
+			treap_node_ptr_pair lower = _split(root, K, true, path);
+			treap_node_ptr_pair upper = _split(lower.second, K, false, path);
+			less = lower.first;
+			equal = upper.first;
+			greater = upper.second;
+		}
 
-			if (tree_left->priority < tree_right->priority)
+		// if [keep_equal], values of both trees are kept (as by insert), otherwise equal values of the other tree are dropped
+		treap_node_ptr _union(treap_node_ptr a, treap_node_ptr b, size_t threads, bool keep_equal)
+		{
+			if (a == nullptr) return b;
+			if (b == nullptr) return a;
+			if (b->priority < a->priority) std::swap(a, b);
+			treap_node_ptr less, equal = nullptr, greater;
+			size_t work = a->sub_tree_size + b->sub_tree_size;
+			if (keep_equal)
 			{
-				treap_node_ptr root = tree_left;
-				root->right = _merge(root->right, tree_right);
-				ON_UPDATE(root);
-				return root;
+				treap_node_ptr_pair sub_trees = _split(b, a->value, true, _thread_path());
+				less = sub_trees.first;
+				greater = sub_trees.second;
 			}
 			else
 			{
-				treap_node_ptr root = tree_right;
-				root->left = _merge(tree_left, root->left);
-				ON_UPDATE(root);
-				return root;
+				_split_equal(b, a->value, less, equal, greater);
 			}
+			_join_children(a, less, greater, work, threads,
+				[this, keep_equal](treap_node_ptr x, treap_node_ptr y, size_t t) { return _union(x, y, t, keep_equal); });
+			a->left = less;
+			a->right = greater;
+			a->_update();
+			_destroy_tree(equal);
+			return a;
 		}
 
-		treap_node_ptr _erase(treap_node_ptr root, const value_type& value)
+		treap_node_ptr _intersection(treap_node_ptr a, treap_node_ptr b, size_t threads)
 		{
-			if (root == nullptr) return nullptr;
+			if (a == nullptr || b == nullptr)
+			{
+				_destroy_tree(a);
+				_destroy_tree(b);
+				return nullptr;
+			}
+			treap_node_ptr less, equal, greater;
+			size_t work = a->sub_tree_size + b->sub_tree_size;
+			_split_equal(b, a->value, less, equal, greater);
+			_join_children(a, less, greater, work, threads,
+				[this](treap_node_ptr x, treap_node_ptr y, size_t t) { return _intersection(x, y, t); });
+			if (equal == nullptr)
+			{
+				_destroy_node(a);
+				return _merge(less, greater, _thread_path());
+			}
+			_destroy_tree(equal);
+			a->left = less;
+			a->right = greater;
+			a->_update();
+			return a;
+		}
 
-			if (root->value < value)
+		treap_node_ptr _difference(treap_node_ptr a, treap_node_ptr b, size_t threads)
+		{
+			if (a == nullptr || b == nullptr)
 			{
-				root->right = _erase(root->right, value);
-				ON_UPDATE(root);
-				return root;
+				_destroy_tree(b);
+				return a;
 			}
-			else if (value < root->value)
+			treap_node_ptr less, equal, greater;
+			size_t work = a->sub_tree_size + b->sub_tree_size;
+			_split_equal(b, a->value, less, equal, greater);
+			_join_children(a, less, greater, work, threads,
+				[this](treap_node_ptr x, treap_node_ptr y, size_t t) { return _difference(x, y, t); });
+			if (equal != nullptr)
 			{
-				root->left = _erase(root->left, value);
-				ON_UPDATE(root);
-				return root;
+				// duplicates of erased value are at the right end of left part and at the left end of right part
+				std::vector<treap_node_ptr>& path = _thread_path();
+				treap_node_ptr_pair left = _split(less, a->value, true, path);
+				treap_node_ptr_pair right = _split(greater, a->value, false, path);
+				_destroy_tree(left.second);
+				_destroy_tree(right.first);
+				_destroy_tree(equal);
+				_destroy_node(a);
+				return _merge(left.first, right.second, path);
 			}
-			else // equality
+			a->left = less;
+			a->right = greater;
+			a->_update();
+			return a;
+		}
+
+		// takes nodes of [other] before set operation with it
+		inline void _take_nodes(treap& other)
+		{
+			if constexpr (treap_is_pool_allocator<allocator>::value)
 			{
-				treap_node_ptr toDelete = root;
-				root = _merge(root->left, root->right);
+				if (other._root != nullptr) _alloc.adopt(other._alloc);
+			}
+		}
 
-				_destroy_node(toDelete);
+		inline void _set_root(treap_node_ptr root)
+		{
+			_root = root;
+			if (_root != nullptr) _root->parent = nullptr;
+			_size = core::size(_root);
+		}
 
-				if (root != nullptr)
+		treap_node_ptr _erase(treap_node_ptr root, const value_type& value)
+		{
+			const size_t base = _path.size();
+			treap_node_ptr* hook = &root;
+			while (*hook != nullptr)
+			{
+				treap_node_ptr current = *hook;
+				if (current->value < value)
+				{
+					_path.push_back(current);
+					hook = &current->right;
+				}
+				else if (value < current->value)
+				{
+					_path.push_back(current);
+					hook = &current->left;
+				}
+				else // equality
 				{
-					ON_UPDATE(root);
+					*hook = _merge(current->left, current->right);
+					_destroy_node(current);
+					break;
 				}
-				return root;
 			}
+			_update_path(base);
+			return root;
 		}
 
-		treap_node_ptr _find(const treap_node_ptr root, const value_type& value) const
+		treap_node_ptr _find(treap_node_ptr root, const value_type& value) const
 		{
-			if (root == nullptr)
-				return nullptr;
+			while (root != nullptr)
+			{
+				if (root->value < value)
+					root = root->right;
+				else if (value < root->value)
+					root = root->left;
+				else // value found
+					return root;
+			}
+			return nullptr;
+		}
 
-			else if (root->value < value)
+		/*
+		summary of values in [first; last). Below the first node inside of the range, the left boundary path
+		contributes node + right subtree in reverse order and the right boundary path contributes left subtree + node in order,
+		so only two paths are visited
+		*/
+		summary_type _query(treap_node_ptr root, const value_type& first, const value_type& last) const
+		{
+			while (root != nullptr && (root->value < first || !(root->value < last)))
 			{
-				return _find(root->right, value);
+				root = (root->value < first) ? root->right : root->left;
 			}
-			else if (value < root->value)
+			if (root == nullptr) return summary_type();
+
+			std::vector<treap_node_ptr> left_parts; // nodes whose value and right subtree are in range
+			for (treap_node_ptr node = root->left; node != nullptr;)
 			{
-				return _find(root->left, value);
+				if (node->value < first)
+				{
+					node = node->right;
+				}
+				else
+				{
+					left_parts.push_back(node);
+					node = node->left;
+				}
 			}
-			else // value found
+			summary_type res = Summary::summarize(root->value);
+			for (treap_node_ptr node : left_parts)
 			{
-				return root;
+				summary_type part = Summary::summarize(node->value);
+				if (node->right != nullptr) part = Summary::combine(part, node->right->summary);
+				res = Summary::combine(part, res);
 			}
+			for (treap_node_ptr node = root->right; node != nullptr;)
+			{
+				if (node->value < last)
+				{
+					if (node->left != nullptr) res = Summary::combine(res, node->left->summary);
+					res = Summary::combine(res, Summary::summarize(node->value));
+					node = node->right;
+				}
+				else
+				{
+					node = node->left;
+				}
+			}
+			return res;
 		}
 
 		template<typename Func>
-		void _apply(const treap_node_ptr root, Func&& func) const
+		void _apply(treap_node_ptr root, Func&& func) const
 		{
-			if (root == nullptr) return;
-
-			_apply(root->left, std::forward<Func>(func));
-			func(root->value);
-			_apply(root->right, std::forward<Func>(func));
+			std::vector<treap_node_ptr> st;
+			while (root != nullptr || !st.empty())
+			{
+				while (root != nullptr)
+				{
+					st.push_back(root);
+					root = root->left;
+				}
+				root = st.back();
+				st.pop_back();
+				func(root->value);
+				root = root->right;
+			}
 		}
 
 		template<typename SortedIt>
-		treap_node_ptr _build(const SortedIt& first, const SortedIt& last)
+		inline treap_node_ptr _build(const SortedIt& first, const SortedIt& last)
+		{
+			return _build(first, last, [](const value_type& value) { return treap_priority<Priority, Random>(value); });
+		}
+
+		template<typename SortedIt, typename PriorityFunc>
+		treap_node_ptr _build(const SortedIt& first, const SortedIt& last, PriorityFunc&& next_priority)
 		{
 			std::vector<treap_node_ptr> st;
 			treap_node_ptr root = nullptr;
 
 			for (SortedIt it = first; it != last; it++)
 			{
-				treap_node_ptr current = _construct_node(*it);
+				treap_node_ptr current = _construct_node(*it, next_priority(*it));
 				treap_node_ptr last_popped = nullptr;
 
 				while (!st.empty())
@@ -357,7 +1186,7 @@ namespace momo
 						break;
 					}
 					last_popped = st.back();
-					ON_UPDATE(last_popped);
+					last_popped->_update();
 					st.pop_back();
 				}
 				if (st.empty())
@@ -368,20 +1197,69 @@ namespace momo
 			}
 			while (!st.empty())
 			{
-				ON_UPDATE(st.back());
+				st.back()->_update();
 				st.pop_back();
 			}
 			return root;
 		}
 
+		/*
+		priorities are generated in one thread (Random is not required to be thread-safe), then every thread
+		builds a treap of its chunk of values and chunks are merged in order, each merge is O(log n)
+		*/
+		template<typename SortedIt>
+		treap_node_ptr _build_parallel(const SortedIt& first, const SortedIt& last, size_t threads)
+		{
+			using category = typename std::iterator_traits<SortedIt>::iterator_category;
+			if constexpr (std::is_base_of<std::random_access_iterator_tag, category>::value)
+			{
+				const size_t n = size_t(last - first);
+				threads = std::min(_allowed_threads(threads), n / treap_parallel_threshold + 1);
+				if (threads > 1)
+				{
+					std::vector<Priority> priorities(n);
+					for (size_t i = 0; i < n; i++)
+					{
+						const value_type& value = first[i];
+						priorities[i] = treap_priority<Priority, Random>(value);
+					}
+					std::vector<treap_node_ptr> roots(threads);
+					std::vector<std::thread> workers;
+					workers.reserve(threads - 1);
+					auto build_chunk = [&](size_t t)
+					{
+						size_t begin = n * t / threads, end = n * (t + 1) / threads;
+						const Priority* priority = priorities.data() + begin;
+						roots[t] = _build(first + begin, first + end, [&priority](const value_type&) { return *priority++; });
+					};
+					for (size_t t = 1; t < threads; t++)
+					{
+						workers.emplace_back(build_chunk, t);
+					}
+					build_chunk(0);
+					for (std::thread& worker : workers)
+					{
+						worker.join();
+					}
+					treap_node_ptr root = nullptr;
+					for (treap_node_ptr chunk : roots)
+					{
+						root = _merge(root, chunk);
+					}
+					return root;
+				}
+			}
+			return _build(first, last);
+		}
+
 		treap_node_ptr _root;
 		size_t _size;
 		allocator _alloc;
-		update_callback _on_update;
+		std::vector<treap_node_ptr> _path; // scratch stack of modifying operations, kept to avoid allocations
 
 	public:
 		inline treap()
-			: _root(nullptr), _size(0), _alloc(), _on_update()
+			: _root(nullptr), _size(0), _alloc()
 		{
 
 		}
@@ -390,36 +1268,47 @@ namespace momo
 		{
 			if (_root != nullptr)
 			{
-				_destroy_node_recursive(_root);
+				_release_tree(_root);
 			}
 		}
 
 		inline treap(treap&& tr) noexcept
-			: _root(tr._root), _size(tr._size), _alloc(std::move(tr._alloc)), _on_update(std::move(tr._on_update))
+			: _root(tr._root), _size(tr._size), _alloc(std::move(tr._alloc))
 		{
 			tr._size = 0;
 			tr._root = nullptr;
 		}
 
 		inline treap(const treap& tr)
-			: _root(_deep_copy_recursive(tr._root)), _size(tr._size), _alloc(tr._alloc), _on_update(tr._on_update)
+			: _root(nullptr), _size(tr._size), _alloc(allocator_traits::select_on_container_copy_construction(tr._alloc))
 		{
-			
+			_root = _deep_copy(tr._root);
 		}
 
 		template<typename SortedIt>
 		inline treap(const SortedIt& first, const SortedIt& last)
+			: _root(nullptr), _size(0), _alloc()
 		{
 			_root = _build(first, last);
 			if (_root != nullptr) _size = _root->sub_tree_size;
 		}
 
+		/*
+		builds treap of sorted values using [threads] threads, random access iterators are required for parallel build
+		*/
+		template<typename SortedIt>
+		inline treap(const SortedIt& first, const SortedIt& last, size_t threads)
+			: _root(nullptr), _size(0), _alloc()
+		{
+			_set_root(_build_parallel(first, last, threads));
+		}
+
 		inline treap& operator=(treap&& tr) noexcept
 		{
+			clear();
 			_root = tr._root;
 			_size = tr._size;
 			_alloc = std::move(tr._alloc);
-			_on_update = std::move(tr._on_update);
 			tr._root = nullptr;
 			tr._size = 0;
 			return *this;
@@ -427,15 +1316,31 @@ namespace momo
 
 		inline treap& operator=(const treap& tr)
 		{
-			_root = _deep_copy_recursive(tr._root);
+			if (this == &tr) return *this;
+			clear();
+			_root = _deep_copy(tr._root);
 			_size = tr._size;
-			_alloc = tr._alloc;
-			_on_update = tr._on_update;
+			return *this;
+		}
+
+		inline iterator begin() const
+		{
+			return iterator(_root == nullptr ? nullptr : core::most_left(_root), this);
 		}
 
 		inline iterator end() const
 		{
-			return iterator(nullptr);
+			return iterator(nullptr, this);
+		}
+
+		inline reverse_iterator rbegin() const
+		{
+			return reverse_iterator(end());
+		}
+
+		inline reverse_iterator rend() const
+		{
+			return reverse_iterator(begin());
 		}
 
 		inline size_t size() const noexcept
@@ -457,7 +1362,7 @@ namespace momo
 		{
 			if (_root != nullptr)
 			{
-				_destroy_node_recursive(_root);
+				_release_tree(_root);
 				_root = nullptr;
 				_size = 0;
 			}
@@ -475,20 +1380,26 @@ namespace momo
 
 		inline const value_type& left() const
 		{
-			return _most_left(_root)->value;
+			return core::most_left(_root)->value;
 		}
 
 		inline const value_type& right() const
 		{
-			return _most_right(_root)->value;
+			return core::most_right(_root)->value;
 		}
 
 		template<typename SortedIt>
 		inline void rebuild(const SortedIt& first, const SortedIt& last)
 		{
-			if (_root != nullptr) _destroy_node_recursive(_root);
-			_root = _build(first, last);
-			_size = _root->sub_tree_size;
+			if (_root != nullptr) _release_tree(_root);
+			_set_root(_build(first, last));
+		}
+
+		template<typename SortedIt>
+		inline void rebuild(const SortedIt& first, const SortedIt& last, size_t threads)
+		{
+			if (_root != nullptr) _release_tree(_root);
+			_set_root(_build_parallel(first, last, threads));
 		}
 
 		inline void insert(const value_type& value)
@@ -505,7 +1416,78 @@ namespace momo
 
 		inline iterator find(const value_type& value) const
 		{
-			return iterator(_find(_root, value));
+			return iterator(_find(_root, value), this);
+		}
+
+		// iterator to the first value which is not less than [value]
+		inline iterator lower_bound(const value_type& value) const
+		{
+			return iterator(core::partition_point(_root, [&value](treap_node_ptr node) { return node->value < value; }), this);
+		}
+
+		// iterator to the first value which is greater than [value]
+		inline iterator upper_bound(const value_type& value) const
+		{
+			return iterator(core::partition_point(_root, [&value](treap_node_ptr node) { return !(value < node->value); }), this);
+		}
+
+		inline std::pair<iterator, iterator> equal_range(const value_type& value) const
+		{
+			return { lower_bound(value), upper_bound(value) };
+		}
+
+		inline size_t count(const value_type& value) const
+		{
+			return order_of_key_upper(value) - order_of_key(value);
+		}
+
+		/*
+		calls func(value) for every value in [first; last) in order. Only subtrees which intersect the range are visited,
+		so it is O(log n + k) for k values in range
+		*/
+		template<typename Func>
+		inline void visit_range(const value_type& first, const value_type& last, Func&& func) const
+		{
+			for (iterator it = lower_bound(first); it != end() && *it < last; ++it)
+			{
+				func(*it);
+			}
+		}
+
+		/*
+		returns [index]-th smallest value, index must be less than size()
+		*/
+		inline const value_type& nth(size_t index) const
+		{
+			return core::nth(_root, index)->value;
+		}
+
+		// summary of all values, treap must not be empty
+		inline const summary_type& summary() const
+		{
+			return _root->summary;
+		}
+
+		/*
+		returns summary of values in [first; last) in O(log n), summary_type() if there are no such values
+		*/
+		inline summary_type query(const value_type& first, const value_type& last) const
+		{
+			return _query(_root, first, last);
+		}
+
+		// returns amount of values which are less or equal to [value]
+		inline size_t order_of_key_upper(const value_type& value) const
+		{
+			return core::count_left(_root, [&value](treap_node_ptr node) { return !(value < node->value); });
+		}
+
+		/*
+		returns amount of values which are less than [value]
+		*/
+		inline size_t order_of_key(const value_type& value) const
+		{
+			return core::count_left(_root, [&value](treap_node_ptr node) { return node->value < value; });
 		}
 
 		inline void erase(const value_type& value)
@@ -529,14 +1511,12 @@ namespace momo
 				p.first._root = sub_trees.first;
 				p.first._size = sub_trees.first->sub_tree_size;
 				p.first._alloc = _alloc;
-				p.first._on_update = _on_update;
 			}
 			if (sub_trees.second != nullptr)
 			{
 				p.second._root = sub_trees.second;
 				p.second._size = sub_trees.second->sub_tree_size;
 				p.second._alloc = _alloc;
-				p.second._on_update = _on_update;
 			}
 
 			_root = nullptr;
@@ -546,7 +1526,7 @@ namespace momo
 
 		inline void merge(treap_pair& treaps)
 		{
-			if (_root != nullptr) _destroy_node_recursive(_root);
+			if (_root != nullptr) _release_tree(_root);
 
 			treap_node_ptr root = _merge(treaps.first._root, treaps.second._root);
 			_root = root;
@@ -554,38 +1534,86 @@ namespace momo
 			if (treaps.first._root != nullptr)
 			{
 				_alloc = std::move(treaps.first._alloc);
-				_on_update = std::move(treaps.first._on_update);
+				if constexpr (treap_is_pool_allocator<allocator>::value)
+				{
+					if (treaps.second._root != nullptr) _alloc.adopt(treaps.second._alloc);
+				}
 			}
 			else
 			{
 				_alloc = std::move(treaps.second._alloc);
-				_on_update = std::move(treaps.second._on_update);
 			}
 
 			treaps.first._root = treaps.second._root = nullptr;
 			treaps.first._size = treaps.second._size = 0;
 		}
 
-		void on_update(update_callback callback)
+		/*
+		set operations with [other] treap, which becomes empty. Values are treated as a set: values of [other]
+		equal to some value of this treap are never added twice. Work is split between [threads] threads
+		by join-based recursion, expected time is O(m log(n / m + 1)) for treaps of sizes m <= n
+		*/
+		inline void set_union(treap&& other, size_t threads = treap_default_threads())
+		{
+			_take_nodes(other);
+			_set_root(_union(_root, other._root, _allowed_threads(threads), false));
+			other._root = nullptr;
+			other._size = 0;
+		}
+
+		// keeps only values which are also in [other]
+		inline void set_intersection(treap&& other, size_t threads = treap_default_threads())
 		{
-			_on_update = std::move(callback);
+			_take_nodes(other);
+			_set_root(_intersection(_root, other._root, _allowed_threads(threads)));
+			other._root = nullptr;
+			other._size = 0;
 		}
 
-		friend inline void swap(treap& tr1, treap& tr2);
+		// erases all values which are in [other]
+		inline void set_difference(treap&& other, size_t threads = treap_default_threads())
+		{
+			_take_nodes(other);
+			_set_root(_difference(_root, other._root, _allowed_threads(threads)));
+			other._root = nullptr;
+			other._size = 0;
+		}
+
+		/*
+		inserts all values of sorted range, as insert of every value would do. Values are built into a treap in O(k)
+		and joined with this one in O(k log(n / k + 1)) expected time, using [threads] threads for large batches
+		*/
+		template<typename SortedIt>
+		inline void insert_batch(const SortedIt& first, const SortedIt& last, size_t threads = treap_default_threads())
+		{
+			_set_root(_union(_root, _build_parallel(first, last, threads), _allowed_threads(threads), true));
+		}
+
+		/*
+		erases all values which are equal to some value of sorted range, in O(k log(n / k + 1)) expected time.
+		Unlike erase, all duplicates of every value are erased
+		*/
+		template<typename SortedIt>
+		inline void erase_batch(const SortedIt& first, const SortedIt& last, size_t threads = treap_default_threads())
+		{
+			_set_root(_difference(_root, _build_parallel(first, last, threads), _allowed_threads(threads)));
+		}
 
 		inline void swap(treap& tr)
 		{
-			swap(*this, tr);
+			std::swap(_root, tr._root);
+			std::swap(_size, tr._size);
+			std::swap(_alloc, tr._alloc);
 		}
 	};
 
-	template<typename T, typename P, typename R, template<typename> class A>
-	inline void swap(treap<T, P, R, A>& tr1, treap<T, P, R, A>& tr2)
+	template<typename T, typename P, typename R, template<typename> class A, typename S>
+	inline void swap(treap<T, P, R, A, S>& tr1, treap<T, P, R, A, S>& tr2)
 	{
-		auto root_tmp = tr1._root;
-		tr1._root = tr2._root;
-		tr2._root = root_tmp;
-		tr1._size = tr1._root->sub_tree_size;
-		tr2._size = tr2._root->sub_tree_size;
+		tr1.swap(tr2);
 	}
+
+	// treap with summary policy and default priority, random and allocator
+	template<typename T, typename Summary>
+	using augmented_treap = treap<T, uint64_t, random_int64, std::allocator, Summary>;
 }
@@ -0,0 +1,504 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "treap.h"
+
+namespace momo
+{
+	/*
+	ordered map based on treap, keys are unique and ordered by [Compare]. Nodes, iterators and tree algorithms are
+	the ones of treap (see treap_core), only ordering by key is defined here. If Compare has is_transparent
+	(as std::less<>), find, count, contains, lower_bound, upper_bound and erase accept any type comparable
+	with the key, so no key or value_type has to be constructed for lookup. Mapped values are changed in place
+	through iterators, operator[] or insert_or_assign. Order statistics (nth, order_of_key) are O(log n)
+	*/
+	template<typename K, typename V, typename Compare = std::less<K>, typename Priority = uint64_t, typename Random = random_int64, template<typename> class Alloc = std::allocator>
+	class treap_map
+	{
+	public:
+		using key_type = K;
+		using mapped_type = V;
+		using value_type = std::pair<const K, V>;
+		using key_compare = Compare;
+		using treap_node = basic_treap_node<value_type, Priority>;
+		using treap_node_ptr = treap_node*;
+		using iterator = treap_iterator<treap_map, false>;
+		using const_iterator = treap_iterator<treap_map, true>;
+		using reverse_iterator = std::reverse_iterator<iterator>;
+		using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+		using allocator = Alloc<treap_node>;
+		using allocator_traits = std::allocator_traits<allocator>;
+
+		friend iterator;
+		friend const_iterator;
+	private:
+		using core = treap_core<treap_node>;
+
+		treap_node_ptr _root = nullptr;
+		size_t _size = 0;
+		Compare _compare;
+		allocator _alloc;
+		std::vector<treap_node_ptr> _path; // scratch stack of split / merge, kept to avoid allocations
+
+		template<typename... Args>
+		treap_node_ptr _construct_node(Args&&... args)
+		{
+			treap_node_ptr node = allocator_traits::allocate(_alloc, 1);
+			allocator_traits::construct(_alloc, node, Priority(0), std::forward<Args>(args)...);
+			node->priority = treap_priority<Priority, Random>(node->value.first);
+			return node;
+		}
+
+		inline void _destroy_node(treap_node_ptr node) noexcept
+		{
+			allocator_traits::destroy(_alloc, node);
+			allocator_traits::deallocate(_alloc, node, 1);
+		}
+
+		inline void _destroy_tree(treap_node_ptr node) noexcept
+		{
+			core::destroy_tree(node, [this](treap_node_ptr p) { _destroy_node(p); });
+		}
+
+		treap_node_ptr _deep_copy(treap_node_ptr from)
+		{
+			return core::deep_copy(from, [this](treap_node_ptr source, treap_node_ptr parent)
+			{
+				treap_node_ptr node = allocator_traits::allocate(_alloc, 1);
+				allocator_traits::construct(_alloc, node, *source);
+				node->parent = parent;
+				return node;
+			});
+		}
+
+		// nodes with keys less than [key] go left
+		template<typename Key>
+		inline auto _less_than(const Key& key) const
+		{
+			return [this, &key](treap_node_ptr node) { return _compare(node->value.first, key); };
+		}
+
+		// [node] key must not be in map
+		void _insert_node(treap_node_ptr node)
+		{
+			_root = core::insert(_root, node, _less_than(node->value.first), _path);
+			_size++;
+		}
+
+		// replaces [node] with merge of its children and recomputes sizes of its ancestors
+		void _erase_node(treap_node_ptr node)
+		{
+			treap_node_ptr parent = node->parent;
+			treap_node_ptr replacement = core::merge(node->left, node->right, _path);
+			if (parent == nullptr) _root = replacement;
+			else if (parent->left == node) parent->left = replacement;
+			else parent->right = replacement;
+			if (replacement != nullptr) replacement->parent = parent;
+			for (; parent != nullptr; parent = parent->parent)
+			{
+				parent->sub_tree_size--;
+			}
+			_destroy_node(node);
+			_size--;
+		}
+
+		template<typename Key>
+		treap_node_ptr _find(const Key& key) const
+		{
+			treap_node_ptr node = _root;
+			while (node != nullptr)
+			{
+				if (_compare(node->value.first, key)) node = node->right;
+				else if (_compare(key, node->value.first)) node = node->left;
+				else return node;
+			}
+			return nullptr;
+		}
+
+		template<typename Key>
+		inline treap_node_ptr _lower_bound(const Key& key) const
+		{
+			return core::partition_point(_root, _less_than(key));
+		}
+
+		template<typename Key>
+		inline treap_node_ptr _upper_bound(const Key& key) const
+		{
+			return core::partition_point(_root, [this, &key](treap_node_ptr node) { return !_compare(key, node->value.first); });
+		}
+
+		template<typename Key>
+		size_t _erase_key(const Key& key)
+		{
+			treap_node_ptr node = _find(key);
+			if (node == nullptr) return 0;
+			_erase_node(node);
+			return 1;
+		}
+
+		template<typename Key>
+		inline size_t _order_of_key(const Key& key) const
+		{
+			return core::count_left(_root, _less_than(key));
+		}
+
+		template<typename Key, typename... Args>
+		std::pair<iterator, bool> _try_emplace(Key&& key, Args&&... args)
+		{
+			treap_node_ptr node = _find(key);
+			if (node != nullptr) return { iterator(node, this), false };
+			node = _construct_node(std::piecewise_construct, std::forward_as_tuple(std::forward<Key>(key)),
+				std::forward_as_tuple(std::forward<Args>(args)...));
+			_insert_node(node);
+			return { iterator(node, this), true };
+		}
+	public:
+		treap_map() = default;
+
+		explicit treap_map(const Compare& compare)
+			: _compare(compare) { }
+
+		treap_map(const treap_map& map)
+			: _size(map._size), _compare(map._compare), _alloc(allocator_traits::select_on_container_copy_construction(map._alloc))
+		{
+			_root = _deep_copy(map._root);
+		}
+
+		treap_map(treap_map&& map) noexcept
+			: _root(map._root), _size(map._size), _compare(std::move(map._compare)), _alloc(std::move(map._alloc))
+		{
+			map._root = nullptr;
+			map._size = 0;
+		}
+
+		treap_map& operator=(const treap_map& map)
+		{
+			if (this == &map) return *this;
+			clear();
+			_compare = map._compare;
+			_root = _deep_copy(map._root);
+			_size = map._size;
+			return *this;
+		}
+
+		treap_map& operator=(treap_map&& map) noexcept
+		{
+			if (this == &map) return *this;
+			clear();
+			_root = map._root;
+			_size = map._size;
+			_compare = std::move(map._compare);
+			_alloc = std::move(map._alloc);
+			map._root = nullptr;
+			map._size = 0;
+			return *this;
+		}
+
+		~treap_map()
+		{
+			_destroy_tree(_root);
+		}
+
+		inline iterator begin() noexcept
+		{
+			return iterator(_root == nullptr ? nullptr : core::most_left(_root), this);
+		}
+
+		inline const_iterator begin() const noexcept
+		{
+			return const_cast<treap_map*>(this)->begin();
+		}
+
+		inline iterator end() noexcept
+		{
+			return iterator(nullptr, this);
+		}
+
+		inline const_iterator end() const noexcept
+		{
+			return const_iterator(nullptr, this);
+		}
+
+		inline const_iterator cbegin() const noexcept
+		{
+			return begin();
+		}
+
+		inline const_iterator cend() const noexcept
+		{
+			return end();
+		}
+
+		inline reverse_iterator rbegin() noexcept
+		{
+			return reverse_iterator(end());
+		}
+
+		inline reverse_iterator rend() noexcept
+		{
+			return reverse_iterator(begin());
+		}
+
+		inline const_reverse_iterator rbegin() const noexcept
+		{
+			return const_reverse_iterator(end());
+		}
+
+		inline const_reverse_iterator rend() const noexcept
+		{
+			return const_reverse_iterator(begin());
+		}
+
+		inline size_t size() const noexcept
+		{
+			return _size;
+		}
+
+		inline bool empty() const noexcept
+		{
+			return _size == 0;
+		}
+
+		inline void clear() noexcept
+		{
+			_destroy_tree(_root);
+			_root = nullptr;
+			_size = 0;
+		}
+
+		inline key_compare key_comp() const
+		{
+			return _compare;
+		}
+
+		inline allocator& get_allocator()
+		{
+			return _alloc;
+		}
+
+		// inserts [value] if its key is not in map, otherwise returns iterator to existing element
+		inline std::pair<iterator, bool> insert(const value_type& value)
+		{
+			return _try_emplace(value.first, value.second);
+		}
+
+		// key of value_type is const and can not be moved from, so it is copied and only mapped value is moved
+		inline std::pair<iterator, bool> insert(value_type&& value)
+		{
+			return _try_emplace(value.first, std::move(value.second));
+		}
+
+		// inserts pair convertible to value_type (as std::pair<K, V>), its key is moved if pair is rvalue
+		template<typename P, typename = typename std::enable_if<std::is_constructible<value_type, P&&>::value>::type>
+		inline std::pair<iterator, bool> insert(P&& value)
+		{
+			return _try_emplace(std::forward<P>(value).first, std::forward<P>(value).second);
+		}
+
+		// constructs mapped value from [args] only if [key] is not in map
+		template<typename... Args>
+		inline std::pair<iterator, bool> try_emplace(const key_type& key, Args&&... args)
+		{
+			return _try_emplace(key, std::forward<Args>(args)...);
+		}
+
+		template<typename... Args>
+		inline std::pair<iterator, bool> try_emplace(key_type&& key, Args&&... args)
+		{
+			return _try_emplace(std::move(key), std::forward<Args>(args)...);
+		}
+
+		// assigns [value] to existing element in place or inserts new one
+		template<typename M>
+		inline std::pair<iterator, bool> insert_or_assign(const key_type& key, M&& value)
+		{
+			treap_node_ptr node = _find(key);
+			if (node == nullptr) return _try_emplace(key, std::forward<M>(value));
+			node->value.second = std::forward<M>(value);
+			return { iterator(node, this), false };
+		}
+
+		template<typename M>
+		inline std::pair<iterator, bool> insert_or_assign(key_type&& key, M&& value)
+		{
+			treap_node_ptr node = _find(key);
+			if (node == nullptr) return _try_emplace(std::move(key), std::forward<M>(value));
+			node->value.second = std::forward<M>(value);
+			return { iterator(node, this), false };
+		}
+
+		// returns reference to mapped value of [key], value-initialized element is inserted if there is none
+		inline mapped_type& operator[](const key_type& key)
+		{
+			return _try_emplace(key).first->second;
+		}
+
+		inline mapped_type& operator[](key_type&& key)
+		{
+			return _try_emplace(std::move(key)).first->second;
+		}
+
+		inline iterator find(const key_type& key)
+		{
+			return iterator(_find(key), this);
+		}
+
+		inline const_iterator find(const key_type& key) const
+		{
+			return const_iterator(_find(key), this);
+		}
+
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline iterator find(const Key& key)
+		{
+			return iterator(_find(key), this);
+		}
+
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline const_iterator find(const Key& key) const
+		{
+			return const_iterator(_find(key), this);
+		}
+
+		inline bool contains(const key_type& key) const
+		{
+			return _find(key) != nullptr;
+		}
+
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline bool contains(const Key& key) const
+		{
+			return _find(key) != nullptr;
+		}
+
+		inline size_t count(const key_type& key) const
+		{
+			return contains(key) ? 1 : 0;
+		}
+
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline size_t count(const Key& key) const
+		{
+			return _find(key) != nullptr ? 1 : 0;
+		}
+
+		inline iterator lower_bound(const key_type& key)
+		{
+			return iterator(_lower_bound(key), this);
+		}
+
+		inline const_iterator lower_bound(const key_type& key) const
+		{
+			return const_iterator(_lower_bound(key), this);
+		}
+
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline iterator lower_bound(const Key& key)
+		{
+			return iterator(_lower_bound(key), this);
+		}
+
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline const_iterator lower_bound(const Key& key) const
+		{
+			return const_iterator(_lower_bound(key), this);
+		}
+
+		inline iterator upper_bound(const key_type& key)
+		{
+			return iterator(_upper_bound(key), this);
+		}
+
+		inline const_iterator upper_bound(const key_type& key) const
+		{
+			return const_iterator(_upper_bound(key), this);
+		}
+
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline iterator upper_bound(const Key& key)
+		{
+			return iterator(_upper_bound(key), this);
+		}
+
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline const_iterator upper_bound(const Key& key) const
+		{
+			return const_iterator(_upper_bound(key), this);
+		}
+
+		// erases element with [key], returns amount of erased elements (0 or 1)
+		inline size_t erase(const key_type& key)
+		{
+			return _erase_key(key);
+		}
+
+		// iterators are not keys even if comparator accepts them, so erase(find(key)) always erases by position
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent,
+			typename = typename std::enable_if<!std::is_convertible<const Key&, const_iterator>::value>::type>
+		inline size_t erase(const Key& key)
+		{
+			return _erase_key(key);
+		}
+
+		// erases element at [it] in O(log n), returns iterator to the next element
+		inline iterator erase(const_iterator it)
+		{
+			treap_node_ptr node = it.node();
+			iterator next(node, this);
+			++next;
+			_erase_node(node);
+			return next;
+		}
+
+		inline iterator erase(iterator it)
+		{
+			return erase(const_iterator(it));
+		}
+
+		/*
+		returns [index]-th element in key order, index must be less than size()
+		*/
+		inline value_type& nth(size_t index)
+		{
+			return core::nth(_root, index)->value;
+		}
+
+		inline const value_type& nth(size_t index) const
+		{
+			return const_cast<treap_map*>(this)->nth(index);
+		}
+
+		// returns amount of keys which are less than [key]
+		inline size_t order_of_key(const key_type& key) const
+		{
+			return _order_of_key(key);
+		}
+
+		template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+		inline size_t order_of_key(const Key& key) const
+		{
+			return _order_of_key(key);
+		}
+
+		inline void swap(treap_map& map)
+		{
+			std::swap(_root, map._root);
+			std::swap(_size, map._size);
+			std::swap(_compare, map._compare);
+			std::swap(_alloc, map._alloc);
+		}
+	};
+
+	template<typename K, typename V, typename C, typename P, typename R, template<typename> class A>
+	inline void swap(treap_map<K, V, C, P, R, A>& map1, treap_map<K, V, C, P, R, A>& map2)
+	{
+		map1.swap(map2);
+	}
+}